@@ -0,0 +1,459 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "router.h"
+#include "search_scratch.h"
+#include "serialization.h"
+
+namespace graph {
+
+// Vertices are contracted one by one, least important first, and shortcuts
+// are added so that every shortest route can be found by a bidirectional
+// search that only goes up the contraction order. BuildRoute may run on many
+// threads at once, each search takes its thread's scratch.
+template <typename Weight>
+class ContractionHierarchy {
+ private:
+  using Graph = DirectedWeightedGraph<Weight>;
+
+ public:
+  using RouteInfo = typename Router<Weight>::RouteInfo;
+
+  // If build is false, the hierarchy is left empty
+  explicit ContractionHierarchy(const Graph& graph, bool build = true);
+
+  std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+  // Contracts the graph anew after it has changed
+  void Rebuild();
+
+  friend class serialization::Saver;
+  friend class serialization::Loader;
+
+ private:
+  static constexpr Weight ZERO_WEIGHT{};
+  static constexpr Weight INFINITE_WEIGHT =
+      std::numeric_limits<Weight>::has_infinity
+          ? std::numeric_limits<Weight>::infinity()
+          : std::numeric_limits<Weight>::max();
+  static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+  // Settled vertex limits of witness searches for contraction and for
+  // importance estimation. Hitting a limit only costs superfluous shortcuts.
+  static constexpr size_t WITNESS_SETTLE_LIMIT = 500;
+  static constexpr size_t SIMULATION_SETTLE_LIMIT = 50;
+
+  // Shortcut ids continue the edge ids of the graph. A shortcut replaces
+  // the path of its two edges, each of them being an edge or a shortcut.
+  struct Shortcut {
+    VertexId from;
+    VertexId to;
+    Weight weight;
+    EdgeId first_edge;
+    EdgeId second_edge;
+  };
+
+  // Edge of the search graph leading to a more important vertex: forward
+  // along the edge for the upward graph, backward for the downward one
+  struct SearchEdge {
+    VertexId vertex;
+    Weight weight;
+    EdgeId edge_id;
+  };
+
+  struct Arc {
+    VertexId vertex;
+    Weight weight;
+    EdgeId edge_id;
+  };
+
+  using Arcs = std::vector<std::vector<Arc>>;
+  using QueueItem = std::pair<Weight, VertexId>;
+  using Queue =
+      std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>;
+  using Scratch = SearchScratch<Weight, EdgeId, QueueItem>;
+
+  struct WitnessSearch {
+    std::vector<Weight> weights;
+    std::vector<VertexId> touched;
+    std::vector<bool> is_target;
+    size_t target_count = 0;
+  };
+
+  void Build();
+  void RunWitnessSearch(const Arcs& out_arcs, VertexId source,
+                        VertexId vertex_skipped, Weight max_weight,
+                        size_t settle_limit, WitnessSearch& search) const;
+  size_t ContractVertex(VertexId vertex, bool simulate, Arcs& out_arcs,
+                        Arcs& in_arcs, WitnessSearch& search);
+  void BuildSearchGraph();
+  Edge<Weight> GetHierarchyEdge(EdgeId edge_id) const;
+  void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const;
+
+  const Graph& graph_;
+  std::vector<uint32_t> ranks_;
+  std::vector<Shortcut> shortcuts_;
+  std::vector<size_t> up_offsets_;
+  std::vector<SearchEdge> up_edges_;
+  std::vector<size_t> down_offsets_;
+  std::vector<SearchEdge> down_edges_;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph,
+                                                   bool build)
+    : graph_(graph) {
+  if (build) {
+    Build();
+    BuildSearchGraph();
+  }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Rebuild() {
+  shortcuts_.clear();
+  Build();
+  BuildSearchGraph();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Build() {
+  const size_t vertex_count = graph_.GetVertexCount();
+  Arcs out_arcs(vertex_count);
+  Arcs in_arcs(vertex_count);
+  for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    const auto edge = graph_.GetEdge(edge_id);
+    if (edge.weight < ZERO_WEIGHT) {
+      throw std::domain_error("Edges' weights should be non-negative");
+    }
+    if (edge.from != edge.to) {
+      out_arcs[edge.from].push_back({edge.to, edge.weight, edge_id});
+      in_arcs[edge.to].push_back({edge.from, edge.weight, edge_id});
+    }
+  }
+
+  // Importance of a vertex is its edge difference plus the number of its
+  // contracted neighbours. It is recomputed lazily when the vertex is popped.
+  WitnessSearch search{std::vector<Weight>(vertex_count, INFINITE_WEIGHT),
+                       {},
+                       std::vector<bool>(vertex_count, false)};
+  std::vector<int64_t> contracted_neighbours(vertex_count, 0);
+  auto get_importance = [&](VertexId vertex) {
+    const auto shortcut_count =
+        ContractVertex(vertex, true, out_arcs, in_arcs, search);
+    return static_cast<int64_t>(shortcut_count) -
+           static_cast<int64_t>(in_arcs[vertex].size() +
+                                out_arcs[vertex].size()) +
+           contracted_neighbours[vertex];
+  };
+
+  using ImportanceItem = std::pair<int64_t, VertexId>;
+  std::priority_queue<ImportanceItem, std::vector<ImportanceItem>,
+                      std::greater<>>
+      queue;
+  for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+    queue.push({get_importance(vertex), vertex});
+  }
+
+  ranks_.assign(vertex_count, 0);
+  uint32_t next_rank = 0;
+  while (!queue.empty()) {
+    const VertexId vertex = queue.top().second;
+    queue.pop();
+    const int64_t importance = get_importance(vertex);
+    if (!queue.empty() && importance > queue.top().first) {
+      queue.push({importance, vertex});
+      continue;
+    }
+
+    ContractVertex(vertex, false, out_arcs, in_arcs, search);
+    ranks_[vertex] = next_rank++;
+    for (const Arc& arc : in_arcs[vertex]) {
+      auto& arcs = out_arcs[arc.vertex];
+      arcs.erase(std::remove_if(arcs.begin(), arcs.end(),
+                                [vertex](const Arc& other) {
+                                  return other.vertex == vertex;
+                                }),
+                 arcs.end());
+      ++contracted_neighbours[arc.vertex];
+    }
+    for (const Arc& arc : out_arcs[vertex]) {
+      auto& arcs = in_arcs[arc.vertex];
+      arcs.erase(std::remove_if(arcs.begin(), arcs.end(),
+                                [vertex](const Arc& other) {
+                                  return other.vertex == vertex;
+                                }),
+                 arcs.end());
+      ++contracted_neighbours[arc.vertex];
+    }
+    in_arcs[vertex] = {};
+    out_arcs[vertex] = {};
+  }
+}
+
+// Dijkstra from source over the remaining graph without vertex_skipped. Stops
+// when all the targets are settled, beyond max_weight or after
+// WITNESS_SETTLE_LIMIT settled vertices.
+template <typename Weight>
+void ContractionHierarchy<Weight>::RunWitnessSearch(
+    const Arcs& out_arcs, VertexId source, VertexId vertex_skipped,
+    Weight max_weight, size_t settle_limit, WitnessSearch& search) const {
+  for (const VertexId vertex : search.touched) {
+    search.weights[vertex] = INFINITE_WEIGHT;
+  }
+  search.touched.clear();
+  const size_t target_count =
+      search.target_count - (search.is_target[source] ? 1 : 0);
+  if (target_count == 0) {
+    return;
+  }
+
+  Queue queue;
+  search.weights[source] = ZERO_WEIGHT;
+  search.touched.push_back(source);
+  queue.push({ZERO_WEIGHT, source});
+  size_t settled_count = 0;
+  size_t settled_target_count = 0;
+  while (!queue.empty()) {
+    const auto [weight, vertex] = queue.top();
+    queue.pop();
+    if (weight > search.weights[vertex]) {
+      continue;
+    }
+    if (weight > max_weight || ++settled_count > settle_limit) {
+      break;
+    }
+    if (vertex != source && search.is_target[vertex] &&
+        ++settled_target_count == target_count) {
+      break;
+    }
+    for (const Arc& arc : out_arcs[vertex]) {
+      if (arc.vertex == vertex_skipped) {
+        continue;
+      }
+      const Weight candidate_weight = weight + arc.weight;
+      if (candidate_weight < search.weights[arc.vertex]) {
+        if (search.weights[arc.vertex] == INFINITE_WEIGHT) {
+          search.touched.push_back(arc.vertex);
+        }
+        search.weights[arc.vertex] = candidate_weight;
+        queue.push({candidate_weight, arc.vertex});
+      }
+    }
+  }
+}
+
+// Returns the number of shortcuts needed to contract the vertex and adds them
+// unless simulate is true
+template <typename Weight>
+size_t ContractionHierarchy<Weight>::ContractVertex(VertexId vertex,
+                                                    bool simulate,
+                                                    Arcs& out_arcs,
+                                                    Arcs& in_arcs,
+                                                    WitnessSearch& search) {
+  if (out_arcs[vertex].empty()) {
+    return 0;
+  }
+  // A witness can only reach the targets entered not only from the vertex
+  Weight max_out_weight = ZERO_WEIGHT;
+  search.target_count = 0;
+  for (const Arc& out : out_arcs[vertex]) {
+    max_out_weight = std::max(max_out_weight, out.weight);
+    const bool has_other_in_arcs = std::any_of(
+        in_arcs[out.vertex].begin(), in_arcs[out.vertex].end(),
+        [vertex](const Arc& in) { return in.vertex != vertex; });
+    if (has_other_in_arcs && !search.is_target[out.vertex]) {
+      search.is_target[out.vertex] = true;
+      ++search.target_count;
+    }
+  }
+
+  size_t shortcut_count = 0;
+  for (const Arc& in : in_arcs[vertex]) {
+    RunWitnessSearch(
+        out_arcs, in.vertex, vertex, in.weight + max_out_weight,
+        simulate ? SIMULATION_SETTLE_LIMIT : WITNESS_SETTLE_LIMIT, search);
+    for (const Arc& out : out_arcs[vertex]) {
+      if (out.vertex == in.vertex) {
+        continue;
+      }
+      const Weight shortcut_weight = in.weight + out.weight;
+      if (search.is_target[out.vertex] &&
+          search.weights[out.vertex] <= shortcut_weight) {
+        continue;
+      }
+      ++shortcut_count;
+      if (!simulate) {
+        const EdgeId shortcut_id = graph_.GetEdgeCount() + shortcuts_.size();
+        shortcuts_.push_back({in.vertex, out.vertex, shortcut_weight,
+                              in.edge_id, out.edge_id});
+        out_arcs[in.vertex].push_back(
+            {out.vertex, shortcut_weight, shortcut_id});
+        in_arcs[out.vertex].push_back(
+            {in.vertex, shortcut_weight, shortcut_id});
+      }
+    }
+  }
+  for (const Arc& out : out_arcs[vertex]) {
+    search.is_target[out.vertex] = false;
+  }
+  return shortcut_count;
+}
+
+// Splits the edges and shortcuts into the upward and the downward search
+// graphs by the ranks of their ends
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildSearchGraph() {
+  const size_t vertex_count = graph_.GetVertexCount();
+  const size_t hierarchy_edge_count =
+      graph_.GetEdgeCount() + shortcuts_.size();
+  up_offsets_.assign(vertex_count + 1, 0);
+  down_offsets_.assign(vertex_count + 1, 0);
+  for (EdgeId edge_id = 0; edge_id < hierarchy_edge_count; ++edge_id) {
+    const auto edge = GetHierarchyEdge(edge_id);
+    if (ranks_[edge.from] < ranks_[edge.to]) {
+      ++up_offsets_[edge.from + 1];
+    } else if (ranks_[edge.from] > ranks_[edge.to]) {
+      ++down_offsets_[edge.to + 1];
+    }
+  }
+  for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+    up_offsets_[vertex + 1] += up_offsets_[vertex];
+    down_offsets_[vertex + 1] += down_offsets_[vertex];
+  }
+
+  up_edges_.resize(up_offsets_.back());
+  down_edges_.resize(down_offsets_.back());
+  std::vector<size_t> up_positions(up_offsets_.begin(), up_offsets_.end() - 1);
+  std::vector<size_t> down_positions(down_offsets_.begin(),
+                                     down_offsets_.end() - 1);
+  for (EdgeId edge_id = 0; edge_id < hierarchy_edge_count; ++edge_id) {
+    const auto edge = GetHierarchyEdge(edge_id);
+    if (ranks_[edge.from] < ranks_[edge.to]) {
+      up_edges_[up_positions[edge.from]++] = {edge.to, edge.weight, edge_id};
+    } else if (ranks_[edge.from] > ranks_[edge.to]) {
+      down_edges_[down_positions[edge.to]++] = {edge.from, edge.weight,
+                                                edge_id};
+    }
+  }
+}
+
+template <typename Weight>
+Edge<Weight> ContractionHierarchy<Weight>::GetHierarchyEdge(
+    EdgeId edge_id) const {
+  if (edge_id < graph_.GetEdgeCount()) {
+    return graph_.GetEdge(edge_id);
+  }
+  const auto& shortcut = shortcuts_.at(edge_id - graph_.GetEdgeCount());
+  return {shortcut.from, shortcut.to, shortcut.weight};
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackEdge(
+    EdgeId edge_id, std::vector<EdgeId>& edges) const {
+  std::vector<EdgeId> stack{edge_id};
+  while (!stack.empty()) {
+    const EdgeId top = stack.back();
+    stack.pop_back();
+    if (top < graph_.GetEdgeCount()) {
+      edges.push_back(top);
+      continue;
+    }
+    const auto& shortcut = shortcuts_[top - graph_.GetEdgeCount()];
+    stack.push_back(shortcut.second_edge);
+    stack.push_back(shortcut.first_edge);
+  }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo>
+ContractionHierarchy<Weight>::BuildRoute(VertexId from, VertexId to) const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count || to >= vertex_count) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+
+  // Upward search from the source, downward one from the destination
+  struct Search {
+    Scratch& scratch;
+    const std::vector<size_t>& offsets;
+    const std::vector<SearchEdge>& edges;
+  };
+  Search searches[2] = {
+      {Scratch::Acquire(vertex_count, 0), up_offsets_, up_edges_},
+      {Scratch::Acquire(vertex_count, 1), down_offsets_, down_edges_}};
+  searches[0].scratch.Set(from, ZERO_WEIGHT, NO_EDGE);
+  searches[0].scratch.Push({ZERO_WEIGHT, from});
+  searches[1].scratch.Set(to, ZERO_WEIGHT, NO_EDGE);
+  searches[1].scratch.Push({ZERO_WEIGHT, to});
+
+  Weight best_weight = INFINITE_WEIGHT;
+  VertexId meeting_vertex = from;
+  auto is_done = [&best_weight](const Search& search) {
+    return search.scratch.IsQueueEmpty() ||
+           search.scratch.Top().first >= best_weight;
+  };
+  while (!is_done(searches[0]) || !is_done(searches[1])) {
+    const size_t direction =
+        is_done(searches[0]) ||
+                (!is_done(searches[1]) && searches[1].scratch.Top().first <
+                                              searches[0].scratch.Top().first)
+            ? 1
+            : 0;
+    Scratch& search = searches[direction].scratch;
+    const Scratch& other = searches[1 - direction].scratch;
+    const auto [weight, vertex] = search.Top();
+    search.Pop();
+    if (weight > search.GetWeight(vertex)) {
+      continue;
+    }
+    if (other.GetWeight(vertex) != INFINITE_WEIGHT &&
+        weight + other.GetWeight(vertex) < best_weight) {
+      best_weight = weight + other.GetWeight(vertex);
+      meeting_vertex = vertex;
+    }
+    const auto& offsets = searches[direction].offsets;
+    const auto& edges = searches[direction].edges;
+    for (size_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i) {
+      const SearchEdge& edge = edges[i];
+      const Weight candidate_weight = weight + edge.weight;
+      if (candidate_weight < search.GetWeight(edge.vertex)) {
+        search.Set(edge.vertex, candidate_weight, edge.edge_id);
+        search.Push({candidate_weight, edge.vertex});
+      }
+    }
+  }
+  if (best_weight == INFINITE_WEIGHT) {
+    return std::nullopt;
+  }
+
+  std::vector<EdgeId> hierarchy_edges;
+  for (VertexId vertex = meeting_vertex;
+       searches[0].scratch.GetEdge(vertex) != NO_EDGE;
+       vertex = GetHierarchyEdge(hierarchy_edges.back()).from) {
+    hierarchy_edges.push_back(searches[0].scratch.GetEdge(vertex));
+  }
+  std::reverse(hierarchy_edges.begin(), hierarchy_edges.end());
+  for (VertexId vertex = meeting_vertex;
+       searches[1].scratch.GetEdge(vertex) != NO_EDGE;
+       vertex = GetHierarchyEdge(hierarchy_edges.back()).to) {
+    hierarchy_edges.push_back(searches[1].scratch.GetEdge(vertex));
+  }
+
+  std::vector<EdgeId> edges;
+  for (const EdgeId edge_id : hierarchy_edges) {
+    UnpackEdge(edge_id, edges);
+  }
+  return RouteInfo{best_weight, std::move(edges)};
+}
+
+}  // namespace graph
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdlib>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include "ranges.h"
@@ -18,62 +22,223 @@ struct Edge {
   Weight weight;
 };
 
+// Iterates over consecutive edge ids
+class EdgeIdIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = EdgeId;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const EdgeId*;
+  using reference = EdgeId;
+
+  explicit EdgeIdIterator(EdgeId edge_id) : edge_id_(edge_id) {}
+
+  EdgeId operator*() const { return edge_id_; }
+  EdgeIdIterator& operator++() {
+    ++edge_id_;
+    return *this;
+  }
+  EdgeIdIterator operator++(int) {
+    EdgeIdIterator old = *this;
+    ++edge_id_;
+    return old;
+  }
+  bool operator==(const EdgeIdIterator& other) const {
+    return edge_id_ == other.edge_id_;
+  }
+  bool operator!=(const EdgeIdIterator& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  EdgeId edge_id_;
+};
+
+// Edges are added one by one, then the graph is frozen into compressed sparse
+// row form: edges are renumbered by source, so the outgoing edges of a vertex
+// are the ids from offsets_[vertex] to offsets_[vertex + 1], and the edge
+// arrays are read sequentially while searching. Only a frozen graph can be
+// searched.
 template <typename Weight>
 class DirectedWeightedGraph {
  private:
-  using IncidenceList = std::vector<EdgeId>;
-  using IncidentEdgesRange =
-      ranges::Range<typename IncidenceList::const_iterator>;
+  using IncidentEdgesRange = ranges::Range<EdgeIdIterator>;
+  using IncomingEdgesRange =
+      ranges::Range<typename std::vector<EdgeId>::const_iterator>;
 
  public:
   DirectedWeightedGraph() = default;
   explicit DirectedWeightedGraph(size_t vertex_count);
+  // Unfreezes the graph and drops the reverse incidence lists until the next
+  // Freeze
   EdgeId AddEdge(const Edge<Weight>& edge);
+  // Sorts the edges by source, keeping the order in which the edges of a
+  // vertex were added. Returns the new id for every old one.
+  std::vector<EdgeId> Freeze();
+  bool IsFrozen() const;
 
   size_t GetVertexCount() const;
   size_t GetEdgeCount() const;
-  const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+  // edge_id must be less than GetEdgeCount()
+  Edge<Weight> GetEdge(EdgeId edge_id) const;
   IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
-  
+
+  // Reverse incidence lists are optional and are not serialized. Once asked
+  // for, they are rebuilt by every Freeze. GetIncomingEdges throws
+  // logic_error while they are dropped.
+  void BuildReverseIncidenceLists();
+  bool HasReverseIncidenceLists() const;
+  IncomingEdgesRange GetIncomingEdges(VertexId vertex) const;
+
   friend class serialization::Saver;
   friend class serialization::Loader;
 
  private:
-  std::vector<Edge<Weight>> edges_;
-  std::vector<IncidenceList> incidence_lists_;
+  void BuildSources();
+  void BuildReverseOffsets();
+
+  size_t vertex_count_ = 0;
+  // Indexed by edge id. Sources are not serialized, they follow from offsets.
+  std::vector<VertexId> sources_;
+  std::vector<VertexId> targets_;
+  std::vector<Weight> weights_;
+  // vertex_count_ + 1 entries in a frozen graph, none otherwise
+  std::vector<EdgeId> offsets_;
+  std::vector<EdgeId> reverse_offsets_;
+  std::vector<EdgeId> reverse_edge_ids_;
+  bool has_reverse_incidence_lists_ = false;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {}
+    : vertex_count_(vertex_count) {}
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
-  edges_.push_back(edge);
-  const EdgeId id = edges_.size() - 1;
-  incidence_lists_.at(edge.from).push_back(id);
-  return id;
+  if (edge.from >= vertex_count_ || edge.to >= vertex_count_) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  sources_.push_back(edge.from);
+  targets_.push_back(edge.to);
+  weights_.push_back(edge.weight);
+  offsets_.clear();
+  reverse_offsets_.clear();
+  reverse_edge_ids_.clear();
+  return sources_.size() - 1;
+}
+
+template <typename Weight>
+std::vector<EdgeId> DirectedWeightedGraph<Weight>::Freeze() {
+  const size_t edge_count = sources_.size();
+  offsets_.assign(vertex_count_ + 1, 0);
+  for (const VertexId source : sources_) {
+    ++offsets_[source + 1];
+  }
+  for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+    offsets_[vertex + 1] += offsets_[vertex];
+  }
+
+  std::vector<EdgeId> new_ids(edge_count);
+  std::vector<EdgeId> positions(offsets_.begin(), offsets_.end() - 1);
+  for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+    new_ids[edge_id] = positions[sources_[edge_id]]++;
+  }
+  std::vector<VertexId> targets(edge_count);
+  std::vector<Weight> weights(edge_count);
+  for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+    targets[new_ids[edge_id]] = targets_[edge_id];
+    weights[new_ids[edge_id]] = weights_[edge_id];
+  }
+  targets_ = std::move(targets);
+  weights_ = std::move(weights);
+  BuildSources();
+  if (has_reverse_incidence_lists_) {
+    BuildReverseOffsets();
+  }
+  return new_ids;
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+  return !offsets_.empty();
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-  return incidence_lists_.size();
+  return vertex_count_;
 }
 
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
-  return edges_.size();
+  return sources_.size();
 }
 
 template <typename Weight>
-const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(
-    EdgeId edge_id) const {
-  return edges_.at(edge_id);
+Edge<Weight> DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+  return {sources_[edge_id], targets_[edge_id], weights_[edge_id]};
 }
 
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-  return ranges::AsRange(incidence_lists_.at(vertex));
+  if (!IsFrozen()) {
+    throw std::logic_error("Graph is not frozen");
+  }
+  return {EdgeIdIterator{offsets_.at(vertex)},
+          EdgeIdIterator{offsets_.at(vertex + 1)}};
 }
-}  // namespace graph
\ No newline at end of file
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::BuildReverseIncidenceLists() {
+  if (!IsFrozen()) {
+    throw std::logic_error("Graph is not frozen");
+  }
+  has_reverse_incidence_lists_ = true;
+  BuildReverseOffsets();
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::HasReverseIncidenceLists() const {
+  return !reverse_offsets_.empty();
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::IncomingEdgesRange
+DirectedWeightedGraph<Weight>::GetIncomingEdges(VertexId vertex) const {
+  if (!HasReverseIncidenceLists()) {
+    throw std::logic_error("Reverse incidence lists are not built");
+  }
+  const auto begin = reverse_edge_ids_.begin();
+  return {begin + reverse_offsets_.at(vertex),
+          begin + reverse_offsets_.at(vertex + 1)};
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::BuildSources() {
+  sources_.resize(targets_.size());
+  for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+    for (EdgeId edge_id = offsets_[vertex]; edge_id < offsets_[vertex + 1];
+         ++edge_id) {
+      sources_[edge_id] = vertex;
+    }
+  }
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::BuildReverseOffsets() {
+  reverse_offsets_.assign(vertex_count_ + 1, 0);
+  for (const VertexId target : targets_) {
+    ++reverse_offsets_[target + 1];
+  }
+  for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+    reverse_offsets_[vertex + 1] += reverse_offsets_[vertex];
+  }
+  reverse_edge_ids_.resize(targets_.size());
+  std::vector<EdgeId> positions(reverse_offsets_.begin(),
+                                reverse_offsets_.end() - 1);
+  for (EdgeId edge_id = 0; edge_id < targets_.size(); ++edge_id) {
+    reverse_edge_ids_[positions[targets_[edge_id]]++] = edge_id;
+  }
+}
+
+}  // namespace graph
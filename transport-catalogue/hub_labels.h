@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "router.h"
+#include "serialization.h"
+
+namespace graph {
+
+// Every vertex keeps the hubs it reaches and the hubs that reach it, with the
+// weights of the routes, such that every pair of vertices shares a hub on a
+// lightest route between them. Labels are built by pruned Dijkstra's searches
+// from the hubs, most important first: a vertex whose route is already
+// covered by the earlier hubs is not labeled and not expanded.
+template <typename Weight>
+class HubLabels {
+ private:
+  using Graph = DirectedWeightedGraph<Weight>;
+
+ public:
+  using RouteInfo = typename Router<Weight>::RouteInfo;
+
+  // If build is false, the labels are left empty
+  explicit HubLabels(const Graph& graph, bool build = true);
+
+  // Merges the two labels, the route is not unpacked
+  std::optional<Weight> BuildRouteWeight(VertexId from, VertexId to) const;
+  std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+  // Labels the graph anew after it has changed
+  void Rebuild();
+
+  friend class serialization::Saver;
+  friend class serialization::Loader;
+
+ private:
+  using LabelEdgeId = uint32_t;
+
+  static constexpr Weight ZERO_WEIGHT{};
+  static constexpr Weight INFINITE_WEIGHT =
+      std::numeric_limits<Weight>::has_infinity
+          ? std::numeric_limits<Weight>::infinity()
+          : std::numeric_limits<Weight>::max();
+  static constexpr LabelEdgeId NO_LABEL_EDGE =
+      std::numeric_limits<LabelEdgeId>::max();
+
+  // Hubs are numbered by importance, so the labels of a vertex are sorted by
+  // hub. edge is the first edge of the route to the hub in out labels and
+  // the last edge of the route from the hub in in labels, the hub's own
+  // label has none. The vertex across the edge has a label of the same hub.
+  struct Label {
+    Weight weight;
+    uint32_t hub;
+    LabelEdgeId edge;
+  };
+
+  // Labels of vertex v are from offsets[v] to offsets[v + 1]
+  struct Labels {
+    std::vector<size_t> offsets;
+    std::vector<Label> labels;
+  };
+
+  struct BestHub {
+    Weight weight;
+    size_t out_index;
+    size_t in_index;
+  };
+
+  void Build();
+  std::vector<VertexId> OrderHubs() const;
+  BestHub FindBestHub(VertexId from, VertexId to) const;
+  const Label& FindLabel(const Labels& labels, VertexId vertex,
+                         uint32_t hub) const;
+
+  const Graph& graph_;
+  Labels out_labels_;
+  Labels in_labels_;
+};
+
+template <typename Weight>
+HubLabels<Weight>::HubLabels(const Graph& graph, bool build) : graph_(graph) {
+  if (build) {
+    Build();
+  }
+}
+
+template <typename Weight>
+void HubLabels<Weight>::Rebuild() {
+  Build();
+}
+
+// Vertices joined to more others are tried as hubs first
+template <typename Weight>
+std::vector<VertexId> HubLabels<Weight>::OrderHubs() const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  std::vector<size_t> degrees(vertex_count, 0);
+  for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    const auto edge = graph_.GetEdge(edge_id);
+    ++degrees[edge.from];
+    ++degrees[edge.to];
+  }
+  std::vector<VertexId> order(vertex_count);
+  for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+    order[vertex] = vertex;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&degrees](VertexId lhs, VertexId rhs) {
+                     return degrees[lhs] > degrees[rhs];
+                   });
+  return order;
+}
+
+template <typename Weight>
+void HubLabels<Weight>::Build() {
+  using QueueItem = std::pair<Weight, VertexId>;
+
+  const size_t vertex_count = graph_.GetVertexCount();
+  const size_t edge_count = graph_.GetEdgeCount();
+  if (edge_count >= NO_LABEL_EDGE) {
+    throw std::length_error("Too many edges for hub labels");
+  }
+  // Incoming edges of every vertex for the backward searches
+  std::vector<size_t> in_offsets(vertex_count + 1, 0);
+  for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+    const auto edge = graph_.GetEdge(edge_id);
+    if (edge.weight < ZERO_WEIGHT) {
+      throw std::domain_error("Edges' weights should be non-negative");
+    }
+    ++in_offsets[edge.to + 1];
+  }
+  for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+    in_offsets[vertex + 1] += in_offsets[vertex];
+  }
+  std::vector<EdgeId> in_edges(edge_count);
+  std::vector<size_t> positions(in_offsets.begin(), in_offsets.end() - 1);
+  for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+    in_edges[positions[graph_.GetEdge(edge_id).to]++] = edge_id;
+  }
+
+  std::vector<std::vector<Label>> vertex_labels[2] = {
+      std::vector<std::vector<Label>>(vertex_count),
+      std::vector<std::vector<Label>>(vertex_count)};
+  std::vector<Weight> weights(vertex_count, INFINITE_WEIGHT);
+  std::vector<LabelEdgeId> edges(vertex_count, NO_LABEL_EDGE);
+  std::vector<VertexId> touched;
+  // Weights of the hub's own labels on the other side, by hub number
+  std::vector<Weight> hub_weights(vertex_count, INFINITE_WEIGHT);
+
+  // The forward search labels the vertices the hub reaches with in labels,
+  // the backward search labels the vertices reaching the hub with out labels
+  auto search = [&](VertexId root, uint32_t hub, bool is_forward) {
+    auto& labels = vertex_labels[is_forward ? 1 : 0];
+    const auto& root_labels = vertex_labels[is_forward ? 0 : 1][root];
+    for (const Label& label : root_labels) {
+      hub_weights[label.hub] = label.weight;
+    }
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>
+        queue;
+    weights[root] = ZERO_WEIGHT;
+    touched.push_back(root);
+    queue.push({ZERO_WEIGHT, root});
+    while (!queue.empty()) {
+      const Weight weight = queue.top().first;
+      const VertexId vertex = queue.top().second;
+      queue.pop();
+      if (weight > weights[vertex]) {
+        continue;
+      }
+      const bool is_covered = std::any_of(
+          labels[vertex].begin(), labels[vertex].end(),
+          [&hub_weights, weight](const Label& label) {
+            return hub_weights[label.hub] != INFINITE_WEIGHT &&
+                   hub_weights[label.hub] + label.weight <= weight;
+          });
+      if (is_covered) {
+        continue;
+      }
+      labels[vertex].push_back({weight, hub, edges[vertex]});
+      auto relax = [&](EdgeId edge_id, VertexId next_vertex) {
+        const Weight candidate_weight =
+            weight + graph_.GetEdge(edge_id).weight;
+        if (candidate_weight < weights[next_vertex]) {
+          if (weights[next_vertex] == INFINITE_WEIGHT) {
+            touched.push_back(next_vertex);
+          }
+          weights[next_vertex] = candidate_weight;
+          edges[next_vertex] = static_cast<LabelEdgeId>(edge_id);
+          queue.push({candidate_weight, next_vertex});
+        }
+      };
+      if (is_forward) {
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+          relax(edge_id, graph_.GetEdge(edge_id).to);
+        }
+      } else {
+        for (size_t i = in_offsets[vertex]; i < in_offsets[vertex + 1]; ++i) {
+          relax(in_edges[i], graph_.GetEdge(in_edges[i]).from);
+        }
+      }
+    }
+    for (const VertexId vertex : touched) {
+      weights[vertex] = INFINITE_WEIGHT;
+      edges[vertex] = NO_LABEL_EDGE;
+    }
+    touched.clear();
+    for (const Label& label : root_labels) {
+      hub_weights[label.hub] = INFINITE_WEIGHT;
+    }
+  };
+
+  const std::vector<VertexId> order = OrderHubs();
+  for (uint32_t hub = 0; hub < vertex_count; ++hub) {
+    search(order[hub], hub, true);
+    search(order[hub], hub, false);
+  }
+
+  Labels* flat_labels[2] = {&out_labels_, &in_labels_};
+  for (size_t side = 0; side < 2; ++side) {
+    Labels& flat = *flat_labels[side];
+    flat.offsets.assign(1, 0);
+    flat.labels.clear();
+    for (auto& labels : vertex_labels[side]) {
+      flat.labels.insert(flat.labels.end(), labels.begin(), labels.end());
+      flat.offsets.push_back(flat.labels.size());
+      labels = {};
+    }
+  }
+}
+
+template <typename Weight>
+typename HubLabels<Weight>::BestHub HubLabels<Weight>::FindBestHub(
+    VertexId from, VertexId to) const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count || to >= vertex_count) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  BestHub best{INFINITE_WEIGHT, 0, 0};
+  size_t i = out_labels_.offsets[from];
+  size_t j = in_labels_.offsets[to];
+  const size_t out_end = out_labels_.offsets[from + 1];
+  const size_t in_end = in_labels_.offsets[to + 1];
+  while (i < out_end && j < in_end) {
+    const Label& out = out_labels_.labels[i];
+    const Label& in = in_labels_.labels[j];
+    if (out.hub < in.hub) {
+      ++i;
+    } else if (in.hub < out.hub) {
+      ++j;
+    } else {
+      if (out.weight + in.weight < best.weight) {
+        best = {out.weight + in.weight, i, j};
+      }
+      ++i;
+      ++j;
+    }
+  }
+  return best;
+}
+
+template <typename Weight>
+const typename HubLabels<Weight>::Label& HubLabels<Weight>::FindLabel(
+    const Labels& labels, VertexId vertex, uint32_t hub) const {
+  const auto begin = labels.labels.begin() + labels.offsets[vertex];
+  const auto end = labels.labels.begin() + labels.offsets[vertex + 1];
+  const auto it = std::lower_bound(
+      begin, end, hub,
+      [](const Label& label, uint32_t hub) { return label.hub < hub; });
+  if (it == end || it->hub != hub) {
+    throw std::logic_error("Hub labels are inconsistent");
+  }
+  return *it;
+}
+
+template <typename Weight>
+std::optional<Weight> HubLabels<Weight>::BuildRouteWeight(VertexId from,
+                                                          VertexId to) const {
+  const BestHub best = FindBestHub(from, to);
+  if (best.weight == INFINITE_WEIGHT) {
+    return std::nullopt;
+  }
+  return best.weight;
+}
+
+// The route goes along the first edges of the out labels up to the hub and
+// then along the last edges of the in labels, collected from the end
+template <typename Weight>
+std::optional<typename HubLabels<Weight>::RouteInfo>
+HubLabels<Weight>::BuildRoute(VertexId from, VertexId to) const {
+  const BestHub best = FindBestHub(from, to);
+  if (best.weight == INFINITE_WEIGHT) {
+    return std::nullopt;
+  }
+  const uint32_t hub = out_labels_.labels[best.out_index].hub;
+  std::vector<EdgeId> edges;
+  for (const Label* label = &out_labels_.labels[best.out_index];
+       label->edge != NO_LABEL_EDGE;
+       label = &FindLabel(out_labels_, graph_.GetEdge(label->edge).to, hub)) {
+    edges.push_back(label->edge);
+  }
+  const size_t hub_position = edges.size();
+  for (const Label* label = &in_labels_.labels[best.in_index];
+       label->edge != NO_LABEL_EDGE;
+       label = &FindLabel(in_labels_, graph_.GetEdge(label->edge).from, hub)) {
+    edges.push_back(label->edge);
+  }
+  std::reverse(edges.begin() + hub_position, edges.end());
+  return RouteInfo{best.weight, std::move(edges)};
+}
+
+}  // namespace graph
@@ -126,9 +126,17 @@ std::string_view InputReader::ParseGetStopInfo(std::string_view str) {
   return Crop(str, " "sv);
 }
 
+// The catalogue is finalized once per run of stat queries, after the
+// changes before them
 void InputReader::ProcessQueries(catalogue::TransportCatalogue& c) {
+  bool is_changed = true;
   for (; !buffer_.empty();) {
     auto query = ParseQuery(buffer_.front());
+    if (is_changed && (query.type == QueryType::GET_BUS_INFO ||
+                       query.type == QueryType::GET_STOP_INFO)) {
+      c.Finalize();
+      is_changed = false;
+    }
     domain::StopData stop;
     domain::BusData bus;
     switch (query.type) {
@@ -139,10 +147,12 @@ void InputReader::ProcessQueries(catalogue::TransportCatalogue& c) {
           c.AddDraftStop(name, {});
           c.SetDistance(stop.name, name, dist);
         }
+        is_changed = true;
         break;
       case QueryType::ADD_BUS:
         bus = ParseAddBus(query.data);
         c.AddBus(bus.name, bus.stops, bus.is_roundtrip);
+        is_changed = true;
         break;
       case QueryType::GET_BUS_INFO:
         stat_reader_.PrintBusInfo(
@@ -77,7 +77,7 @@ ArrayContext Builder::StartArray() {
     throw std::logic_error("dict {["s);
   }
   if (nodes_stack_.back()->IsArray()) {
-    auto new_arr =
+    auto& new_arr =
         nodes_stack_.back()->AsModArray().emplace_back(Node{Array{}});
     nodes_stack_.emplace_back(&new_arr);
     return {*this};
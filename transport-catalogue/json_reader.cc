@@ -34,10 +34,17 @@ void JSONreader::ProcessBaseRequests(TrCat& c) const {
       }
     }
     if (type == "Bus"s) {
+      // Updates of a base may remove buses
+      if (const auto it = req_dict.find("removed"s);
+          it != req_dict.end() && it->second.AsBool()) {
+        c.RemoveBus(req_dict.at("name"s).AsString());
+        continue;
+      }
       BusData bus = ProcessBus(req_dict);
       c.AddBus(bus.name, bus.stops, bus.is_roundtrip);
     }
   }
+  c.Finalize();
 }
 
 StopData JSONreader::ProcessStop(const json::Dict& stop_as_dict) const {
@@ -93,6 +100,50 @@ svg::Color JSONreader::GetColor(const json::Node& color) const {
   throw std::invalid_argument("Invalid argument in GetColor() method");
 }
 
+transport_router::RouterMode JSONreader::GetRouterMode(
+    const json::Node& mode) const {
+  using transport_router::RouterMode;
+  const auto& name = mode.AsString();
+  if (name == "precomputed"s) {
+    return RouterMode::PRECOMPUTED;
+  }
+  if (name == "on_demand"s) {
+    return RouterMode::ON_DEMAND;
+  }
+  if (name == "contraction_hierarchy"s) {
+    return RouterMode::CONTRACTION_HIERARCHY;
+  }
+  if (name == "a_star"s) {
+    return RouterMode::A_STAR;
+  }
+  if (name == "bidirectional"s) {
+    return RouterMode::BIDIRECTIONAL;
+  }
+  if (name == "raptor"s) {
+    return RouterMode::RAPTOR;
+  }
+  if (name == "lazy_rows"s) {
+    return RouterMode::LAZY_ROWS;
+  }
+  if (name == "hub_labels"s) {
+    return RouterMode::HUB_LABELS;
+  }
+  throw std::invalid_argument("Invalid argument in GetRouterMode() method");
+}
+
+transport_router::GraphModel JSONreader::GetGraphModel(
+    const json::Node& graph_model) const {
+  using transport_router::GraphModel;
+  const auto& name = graph_model.AsString();
+  if (name == "complete"s) {
+    return GraphModel::COMPLETE;
+  }
+  if (name == "route_pattern"s) {
+    return GraphModel::ROUTE_PATTERN;
+  }
+  throw std::invalid_argument("Invalid argument in GetGraphModel() method");
+}
+
 RendSett JSONreader::GetRenderSettings() const {
   RendSett render_settings;
   const auto& s = document_.GetRoot().AsDict().at("render_settings"s).AsDict();
@@ -126,6 +177,29 @@ RoutSett JSONreader::GetRoutingSettings() const {
   const auto& s = document_.GetRoot().AsDict().at("routing_settings"s).AsDict();
   routing_settings.bus_wait_time = s.at("bus_wait_time"s).AsInt();
   routing_settings.bus_velocity = s.at("bus_velocity"s).AsDouble();
+  if (s.count("router_mode"s) != 0) {
+    routing_settings.router_mode = GetRouterMode(s.at("router_mode"s));
+  }
+  if (s.count("graph_model"s) != 0) {
+    routing_settings.graph_model = GetGraphModel(s.at("graph_model"s));
+  }
+  if (s.count("route_cache_size"s) != 0) {
+    const int route_cache_size = s.at("route_cache_size"s).AsInt();
+    if (route_cache_size < 0) {
+      throw std::invalid_argument("Route cache size should be non-negative");
+    }
+    routing_settings.route_cache_size = route_cache_size;
+  }
+  if (s.count("row_cache_size"s) != 0) {
+    const int row_cache_size = s.at("row_cache_size"s).AsInt();
+    if (row_cache_size < 0) {
+      throw std::invalid_argument("Row cache size should be non-negative");
+    }
+    routing_settings.row_cache_size = row_cache_size;
+  }
+  if (s.count("save_route_rows"s) != 0) {
+    routing_settings.save_route_rows = s.at("save_route_rows"s).AsBool();
+  }
   return routing_settings;
 }
 
@@ -29,6 +29,9 @@ class JSONreader {
   domain::StopData ProcessStop(const json::Dict& stop_map) const;
   domain::BusData ProcessBus(const json::Dict& bus_as_dict) const;
   svg::Color GetColor(const json::Node& color) const;
+  transport_router::RouterMode GetRouterMode(const json::Node& mode) const;
+  transport_router::GraphModel GetGraphModel(
+      const json::Node& graph_model) const;
 
   json::Document document_;
 };
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lru_cache {
+
+struct CacheStats {
+  size_t hits;
+  size_t misses;
+};
+
+// Thread-safe LRU cache. Keys are spread over shards by hash, every shard has
+// its own lock and evicts its least recently used entry when full. A cache of
+// zero capacity stores nothing.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedLruCache {
+ public:
+  static constexpr size_t MAX_SHARD_COUNT = 16;
+
+  explicit ShardedLruCache(size_t capacity = 0) { Reset(capacity); }
+
+  // Drops all entries and counters. Not thread-safe.
+  void Reset(size_t capacity) {
+    shards_.clear();
+    if (capacity == 0) {
+      return;
+    }
+    const size_t shard_count = std::min(capacity, MAX_SHARD_COUNT);
+    for (size_t i = 0; i < shard_count; ++i) {
+      // The first capacity % shard_count shards take one extra entry
+      shards_.push_back(std::make_unique<Shard>(
+          capacity / shard_count + (i < capacity % shard_count ? 1 : 0)));
+    }
+  }
+
+  bool IsEnabled() const { return !shards_.empty(); }
+
+  std::optional<Value> Find(const Key& key) {
+    if (!IsEnabled()) {
+      return std::nullopt;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      ++shard.misses;
+      return std::nullopt;
+    }
+    ++shard.hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->second;
+  }
+
+  void Insert(const Key& key, Value value) {
+    if (!IsEnabled()) {
+      return;
+    }
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+      it->second->second = std::move(value);
+      shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+      return;
+    }
+    if (shard.entries.size() == shard.capacity) {
+      shard.index.erase(shard.entries.back().first);
+      shard.entries.pop_back();
+    }
+    shard.entries.emplace_front(key, std::move(value));
+    shard.index.emplace(key, shard.entries.begin());
+  }
+
+  // Entries of every shard, most recently used first
+  std::vector<std::pair<Key, Value>> GetEntries() const {
+    std::vector<std::pair<Key, Value>> entries;
+    for (const auto& shard : shards_) {
+      std::lock_guard guard(shard->mutex);
+      entries.insert(entries.end(), shard->entries.begin(),
+                     shard->entries.end());
+    }
+    return entries;
+  }
+
+  CacheStats GetStats() const {
+    CacheStats stats{0, 0};
+    for (const auto& shard : shards_) {
+      std::lock_guard guard(shard->mutex);
+      stats.hits += shard->hits;
+      stats.misses += shard->misses;
+    }
+    return stats;
+  }
+
+ private:
+  using Entries = std::list<std::pair<Key, Value>>;
+
+  struct Shard {
+    explicit Shard(size_t capacity) : capacity(capacity) {}
+
+    const size_t capacity;
+    mutable std::mutex mutex;
+    size_t hits = 0;
+    size_t misses = 0;
+    Entries entries;
+    std::unordered_map<Key, typename Entries::iterator, Hash> index;
+  };
+
+  Shard& GetShard(const Key& key) {
+    // The low bits of std::hash for integers are the key itself, so they are
+    // mixed before picking a shard
+    size_t hash = Hash{}(key);
+    hash ^= hash >> 17;
+    hash *= 0x9E3779B97F4A7C15ull;
+    return *shards_[(hash >> 32) % shards_.size()];
+  }
+
+  // Shards are held by pointers to keep the cache movable
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace lru_cache
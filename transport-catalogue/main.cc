@@ -1,4 +1,6 @@
+#include <charconv>
 #include <iostream>
+#include <optional>
 #include <string_view>
 
 #include "serialization.h"
@@ -6,23 +8,61 @@
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-  stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+  stream << "Usage: transport_catalogue "
+            "[make_base|update_base|process_requests] [--threads=N] "
+            "[--cache-stats]\n"
+            "  --cache-stats  print hits and misses of the route and row "
+            "caches of process_requests to stderr\n"sv;
+}
+
+std::optional<size_t> ParseThreadCount(std::string_view option) {
+  constexpr std::string_view prefix = "--threads="sv;
+  if (option.substr(0, prefix.size()) != prefix) {
+    return std::nullopt;
+  }
+  option.remove_prefix(prefix.size());
+  size_t thread_count = 0;
+  const auto [ptr, ec] = std::from_chars(
+      option.data(), option.data() + option.size(), thread_count);
+  if (ec != std::errc{} || ptr != option.data() + option.size() ||
+      thread_count == 0) {
+    return std::nullopt;
+  }
+  return thread_count;
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
+  if (argc < 2) {
     PrintUsage();
     return 1;
   }
 
   const std::string_view mode(argv[1]);
+  size_t thread_count = 1;
+  bool print_cache_stats = false;
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view option(argv[i]);
+    if (option == "--cache-stats"sv) {
+      print_cache_stats = true;
+      continue;
+    }
+    const auto parsed_thread_count = ParseThreadCount(option);
+    if (!parsed_thread_count) {
+      PrintUsage();
+      return 1;
+    }
+    thread_count = *parsed_thread_count;
+  }
 
   if (mode == "make_base"sv) {
-    serialization::MakeBase(std::cin);
+    serialization::MakeBase(std::cin, thread_count);
+  } else if (mode == "update_base"sv) {
+    serialization::UpdateBase(std::cin, thread_count);
   } else if (mode == "process_requests"sv) {
-    serialization::ProcessRequests(std::cin, std::cout);
+    serialization::ProcessRequests(std::cin, std::cout, thread_count,
+                                   print_cache_stats ? &std::cerr : nullptr);
   } else {
     PrintUsage();
     return 1;
   }
-}
\ No newline at end of file
+}
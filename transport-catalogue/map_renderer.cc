@@ -29,17 +29,23 @@ void MapRenderer::RenderMap(const TrCat& cat,
   };
 
   std::set<domain::Stop, Cmp> unique_stops;
+  std::vector<bool> is_stop_added(cat.GetStopCount(), false);
 
+  // Buses are looked up by name once, their stops by id
   for (const auto& b : bus_names) {
+    const catalogue::BusId bus_id = *cat.FindBus(b);
     domain::Bus bus;
     bus.name = b;
-    for (const auto& s : cat.GetStopsForBus(b)) {
-      auto geo_coords = cat.GetCoordinates(s);
-      sp_init.push_back(geo_coords);
-      bus.stops.emplace_back(domain::Stop{s, geo_coords});
-      unique_stops.emplace(domain::Stop{s, geo_coords});
+    for (const catalogue::StopId s : cat.GetBusStops(bus_id)) {
+      const domain::Stop stop{cat.GetStopName(s), cat.GetCoordinates(s)};
+      sp_init.push_back(stop.coordinates);
+      bus.stops.push_back(stop);
+      if (!is_stop_added[s]) {
+        is_stop_added[s] = true;
+        unique_stops.insert(stop);
+      }
     }
-    bus.is_roundtrip = cat.IsRoundTrip(b);
+    bus.is_roundtrip = cat.IsRoundTrip(bus_id);
     if (!bus.stops.empty()) {
       buses.push_back(std::move(bus));
     }
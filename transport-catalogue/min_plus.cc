@@ -0,0 +1,219 @@
+#include "min_plus.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MIN_PLUS_X86
+#include <immintrin.h>
+#endif
+
+namespace min_plus {
+
+#ifdef MIN_PLUS_X86
+namespace {
+
+// Improved cells are found by a comparison mask. Weights and previous edges
+// are then blended under the mask, and the previous edge of the vertex's row
+// is replaced by prev_edge_from where it has none.
+
+__m128i Select(__m128i mask, __m128i if_set, __m128i if_clear) {
+  return _mm_or_si128(_mm_and_si128(mask, if_set),
+                      _mm_andnot_si128(mask, if_clear));
+}
+
+void RelaxRowSse2(double* weights, PrevEdgeId* prev_edges,
+                  const double* weights_through,
+                  const PrevEdgeId* prev_edges_through, size_t count,
+                  double weight_from, PrevEdgeId prev_edge_from) {
+  const __m128d from = _mm_set1_pd(weight_from);
+  const __m128i fallback = _mm_set1_epi32(static_cast<int>(prev_edge_from));
+  const __m128i no_prev_edge = _mm_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const __m128d current = _mm_loadu_pd(weights + i);
+    const __m128d candidate =
+        _mm_add_pd(from, _mm_loadu_pd(weights_through + i));
+    const __m128d is_lighter = _mm_cmplt_pd(candidate, current);
+    if (_mm_movemask_pd(is_lighter) == 0) {
+      continue;
+    }
+    _mm_storeu_pd(weights + i,
+                  _mm_or_pd(_mm_and_pd(is_lighter, candidate),
+                            _mm_andnot_pd(is_lighter, current)));
+    // Low halves of the two 64-bit lanes make the mask of two edge ids
+    const __m128i mask = _mm_shuffle_epi32(_mm_castpd_si128(is_lighter),
+                                           _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128i through = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(prev_edges_through + i));
+    const __m128i next = Select(_mm_cmpeq_epi32(through, no_prev_edge),
+                                fallback, through);
+    __m128i* prev = reinterpret_cast<__m128i*>(prev_edges + i);
+    _mm_storel_epi64(prev, Select(mask, next, _mm_loadl_epi64(prev)));
+  }
+  RelaxRowScalar(weights + i, prev_edges + i, weights_through + i,
+                 prev_edges_through + i, count - i, weight_from,
+                 prev_edge_from);
+}
+
+// Eight cells at a time, so that one test skips both vectors of weights
+__attribute__((target("avx2"))) void RelaxRowAvx2(
+    double* weights, PrevEdgeId* prev_edges, const double* weights_through,
+    const PrevEdgeId* prev_edges_through, size_t count, double weight_from,
+    PrevEdgeId prev_edge_from) {
+  const __m256d from = _mm256_set1_pd(weight_from);
+  const __m256i fallback =
+      _mm256_set1_epi32(static_cast<int>(prev_edge_from));
+  const __m256i no_prev_edge = _mm256_set1_epi32(-1);
+  const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256d current_low = _mm256_loadu_pd(weights + i);
+    const __m256d current_high = _mm256_loadu_pd(weights + i + 4);
+    const __m256d candidate_low =
+        _mm256_add_pd(from, _mm256_loadu_pd(weights_through + i));
+    const __m256d candidate_high =
+        _mm256_add_pd(from, _mm256_loadu_pd(weights_through + i + 4));
+    const __m256d is_lighter_low =
+        _mm256_cmp_pd(candidate_low, current_low, _CMP_LT_OQ);
+    const __m256d is_lighter_high =
+        _mm256_cmp_pd(candidate_high, current_high, _CMP_LT_OQ);
+    const __m256d is_lighter = _mm256_or_pd(is_lighter_low, is_lighter_high);
+    if (_mm256_testz_pd(is_lighter, is_lighter)) {
+      continue;
+    }
+    _mm256_storeu_pd(weights + i, _mm256_blendv_pd(current_low, candidate_low,
+                                                   is_lighter_low));
+    _mm256_storeu_pd(
+        weights + i + 4,
+        _mm256_blendv_pd(current_high, candidate_high, is_lighter_high));
+    // Low halves of the 64-bit lanes of both masks make the mask of eight
+    // edge ids
+    const __m256i mask = _mm256_permute2x128_si256(
+        _mm256_permutevar8x32_epi32(_mm256_castpd_si256(is_lighter_low),
+                                    low_halves),
+        _mm256_permutevar8x32_epi32(_mm256_castpd_si256(is_lighter_high),
+                                    low_halves),
+        0x20);
+    const __m256i through = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(prev_edges_through + i));
+    const __m256i next = _mm256_blendv_epi8(
+        through, fallback, _mm256_cmpeq_epi32(through, no_prev_edge));
+    __m256i* prev = reinterpret_cast<__m256i*>(prev_edges + i);
+    _mm256_storeu_si256(
+        prev, _mm256_blendv_epi8(_mm256_loadu_si256(prev), next, mask));
+  }
+  RelaxRowScalar(weights + i, prev_edges + i, weights_through + i,
+                 prev_edges_through + i, count - i, weight_from,
+                 prev_edge_from);
+}
+
+// Integral weights compare weights_through[i] < weights[i] - weight_from,
+// which cannot overflow for non-negative weights, and missing routes never
+// pass it
+
+void RelaxRowSse2(int32_t* weights, PrevEdgeId* prev_edges,
+                  const int32_t* weights_through,
+                  const PrevEdgeId* prev_edges_through, size_t count,
+                  int32_t weight_from, PrevEdgeId prev_edge_from) {
+  const __m128i from = _mm_set1_epi32(weight_from);
+  const __m128i fallback = _mm_set1_epi32(static_cast<int>(prev_edge_from));
+  const __m128i no_prev_edge = _mm_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i* current_ptr = reinterpret_cast<__m128i*>(weights + i);
+    const __m128i current = _mm_loadu_si128(current_ptr);
+    const __m128i weight_through = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(weights_through + i));
+    const __m128i is_lighter =
+        _mm_cmpgt_epi32(_mm_sub_epi32(current, from), weight_through);
+    if (_mm_movemask_epi8(is_lighter) == 0) {
+      continue;
+    }
+    _mm_storeu_si128(current_ptr,
+                     Select(is_lighter, _mm_add_epi32(from, weight_through),
+                            current));
+    const __m128i through = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(prev_edges_through + i));
+    const __m128i next = Select(_mm_cmpeq_epi32(through, no_prev_edge),
+                                fallback, through);
+    __m128i* prev = reinterpret_cast<__m128i*>(prev_edges + i);
+    _mm_storeu_si128(prev, Select(is_lighter, next, _mm_loadu_si128(prev)));
+  }
+  RelaxRowScalar(weights + i, prev_edges + i, weights_through + i,
+                 prev_edges_through + i, count - i, weight_from,
+                 prev_edge_from);
+}
+
+__attribute__((target("avx2"))) void RelaxRowAvx2(
+    int32_t* weights, PrevEdgeId* prev_edges, const int32_t* weights_through,
+    const PrevEdgeId* prev_edges_through, size_t count, int32_t weight_from,
+    PrevEdgeId prev_edge_from) {
+  const __m256i from = _mm256_set1_epi32(weight_from);
+  const __m256i fallback =
+      _mm256_set1_epi32(static_cast<int>(prev_edge_from));
+  const __m256i no_prev_edge = _mm256_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i* current_ptr = reinterpret_cast<__m256i*>(weights + i);
+    const __m256i current = _mm256_loadu_si256(current_ptr);
+    const __m256i weight_through = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(weights_through + i));
+    const __m256i is_lighter =
+        _mm256_cmpgt_epi32(_mm256_sub_epi32(current, from), weight_through);
+    if (_mm256_testz_si256(is_lighter, is_lighter)) {
+      continue;
+    }
+    _mm256_storeu_si256(
+        current_ptr,
+        _mm256_blendv_epi8(current, _mm256_add_epi32(from, weight_through),
+                           is_lighter));
+    const __m256i through = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(prev_edges_through + i));
+    const __m256i next = _mm256_blendv_epi8(
+        through, fallback, _mm256_cmpeq_epi32(through, no_prev_edge));
+    __m256i* prev = reinterpret_cast<__m256i*>(prev_edges + i);
+    _mm256_storeu_si256(
+        prev, _mm256_blendv_epi8(_mm256_loadu_si256(prev), next, is_lighter));
+  }
+  RelaxRowScalar(weights + i, prev_edges + i, weights_through + i,
+                 prev_edges_through + i, count - i, weight_from,
+                 prev_edge_from);
+}
+
+}  // namespace
+#endif
+
+// x86-64 always has SSE2, AVX2 is asked of the CPU
+template <typename Weight>
+std::vector<NamedKernel<Weight>> GetKernels() {
+  std::vector<NamedKernel<Weight>> kernels{{"scalar", RelaxRowScalar<Weight>}};
+#ifdef MIN_PLUS_X86
+  kernels.push_back({"sse2", RelaxRowSse2});
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back({"avx2", RelaxRowAvx2});
+  }
+#endif
+  return kernels;
+}
+
+template std::vector<NamedKernel<double>> GetKernels();
+template std::vector<NamedKernel<int32_t>> GetKernels();
+
+// The kernel is selected once
+void RelaxRow(double* weights, PrevEdgeId* prev_edges,
+              const double* weights_through,
+              const PrevEdgeId* prev_edges_through, size_t count,
+              double weight_from, PrevEdgeId prev_edge_from) {
+  static const Kernel<double> kernel = GetKernels<double>().back().kernel;
+  kernel(weights, prev_edges, weights_through, prev_edges_through, count,
+         weight_from, prev_edge_from);
+}
+
+void RelaxRow(int32_t* weights, PrevEdgeId* prev_edges,
+              const int32_t* weights_through,
+              const PrevEdgeId* prev_edges_through, size_t count,
+              int32_t weight_from, PrevEdgeId prev_edge_from) {
+  static const Kernel<int32_t> kernel = GetKernels<int32_t>().back().kernel;
+  kernel(weights, prev_edges, weights_through, prev_edges_through, count,
+         weight_from, prev_edge_from);
+}
+
+}  // namespace min_plus
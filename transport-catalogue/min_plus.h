@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace min_plus {
+
+// Previous edge ids of the all-pairs table, NO_PREV_EDGE for none
+using PrevEdgeId = uint32_t;
+inline constexpr PrevEdgeId NO_PREV_EDGE =
+    std::numeric_limits<PrevEdgeId>::max();
+
+// Relaxes count cells of a table row through a vertex:
+//   weights[i] = min(weights[i], weight_from + weights_through[i])
+// where weight_from is the row's weight to the vertex and weights_through
+// is the vertex's own row. An improved cell takes the previous edge of the
+// vertex's row, or prev_edge_from if that cell has none. Missing routes are
+// infinity, or the maximum of an integral weight.
+template <typename Weight>
+void RelaxRowScalar(Weight* weights, PrevEdgeId* prev_edges,
+                    const Weight* weights_through,
+                    const PrevEdgeId* prev_edges_through, size_t count,
+                    Weight weight_from, PrevEdgeId prev_edge_from) {
+  constexpr Weight INFINITE_WEIGHT =
+      std::numeric_limits<Weight>::has_infinity
+          ? std::numeric_limits<Weight>::infinity()
+          : std::numeric_limits<Weight>::max();
+  for (size_t i = 0; i < count; ++i) {
+    if (weights_through[i] == INFINITE_WEIGHT) {
+      continue;
+    }
+    const Weight candidate_weight = weight_from + weights_through[i];
+    if (candidate_weight < weights[i]) {
+      weights[i] = candidate_weight;
+      prev_edges[i] = prev_edges_through[i] != NO_PREV_EDGE
+                          ? prev_edges_through[i]
+                          : prev_edge_from;
+    }
+  }
+}
+
+template <typename Weight>
+void RelaxRow(Weight* weights, PrevEdgeId* prev_edges,
+              const Weight* weights_through,
+              const PrevEdgeId* prev_edges_through, size_t count,
+              Weight weight_from, PrevEdgeId prev_edge_from) {
+  RelaxRowScalar(weights, prev_edges, weights_through, prev_edges_through,
+                 count, weight_from, prev_edge_from);
+}
+
+template <typename Weight>
+using Kernel = void (*)(Weight*, PrevEdgeId*, const Weight*,
+                        const PrevEdgeId*, size_t, Weight, PrevEdgeId);
+
+template <typename Weight>
+struct NamedKernel {
+  const char* name;
+  Kernel<Weight> kernel;
+};
+
+// Kernels of double or int32_t weights the CPU can run, the scalar one first
+// and the one RelaxRow uses last. All of them give the same row.
+template <typename Weight>
+std::vector<NamedKernel<Weight>> GetKernels();
+
+// Vectorized kernels, AVX2 if the CPU has it, else SSE2 on x86-64, else the
+// scalar one. weight_from must be finite and weights non-negative.
+void RelaxRow(double* weights, PrevEdgeId* prev_edges,
+              const double* weights_through,
+              const PrevEdgeId* prev_edges_through, size_t count,
+              double weight_from, PrevEdgeId prev_edge_from);
+void RelaxRow(int32_t* weights, PrevEdgeId* prev_edges,
+              const int32_t* weights_through,
+              const PrevEdgeId* prev_edges_through, size_t count,
+              int32_t weight_from, PrevEdgeId prev_edge_from);
+
+}  // namespace min_plus
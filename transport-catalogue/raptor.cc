@@ -0,0 +1,173 @@
+#include "raptor.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace raptor {
+
+namespace {
+
+constexpr double INFINITE_WEIGHT = std::numeric_limits<double>::infinity();
+constexpr size_t NO_POSITION = std::numeric_limits<size_t>::max();
+
+}  // namespace
+
+Raptor::Raptor(size_t stop_count, std::vector<Route> routes,
+               double boarding_time)
+    : stop_count_(stop_count),
+      routes_(std::move(routes)),
+      stop_routes_(stop_count),
+      boarding_time_(boarding_time) {
+  for (size_t route = 0; route < routes_.size(); ++route) {
+    const auto& stops = routes_[route].stops;
+    if (!stops.empty() &&
+        routes_[route].segment_times.size() != stops.size() - 1) {
+      throw std::invalid_argument("Route segment count mismatch");
+    }
+    for (size_t position = 0; position < stops.size(); ++position) {
+      stop_routes_.at(stops[position]).push_back({route, position});
+    }
+  }
+}
+
+const Route& Raptor::GetRoute(size_t route) const { return routes_.at(route); }
+
+std::optional<Journey> Raptor::FindJourney(size_t from, size_t to) const {
+  auto journeys = FindParetoJourneys(from, to);
+  if (journeys.empty()) {
+    return std::nullopt;
+  }
+  return std::move(journeys.back());
+}
+
+std::vector<Journey> Raptor::FindParetoJourneys(size_t from, size_t to) const {
+  if (from >= stop_count_ || to >= stop_count_) {
+    throw std::out_of_range("Stop index is out of range");
+  }
+  if (from == to) {
+    return {Journey{0., {}}};
+  }
+  std::vector<Journey> journeys;
+  Rounds rounds;
+  rounds.arrivals.emplace_back(stop_count_, INFINITE_WEIGHT);
+  rounds.legs.emplace_back(stop_count_);
+  rounds.arrivals[0][from] = 0.;
+  Scan scan(stop_count_, routes_.size(), from);
+  for (size_t round = 1; !scan.marked_stops.empty(); ++round) {
+    rounds.arrivals.push_back(rounds.arrivals.back());
+    rounds.legs.emplace_back(stop_count_);
+    ScanRoutes(scan, rounds.arrivals[round - 1], rounds.arrivals[round],
+               &rounds.legs[round], to, INFINITE_WEIGHT);
+    if (rounds.arrivals[round][to] < rounds.arrivals[round - 1][to]) {
+      journeys.push_back(CollectJourney(rounds, round, from, to));
+    }
+  }
+  return journeys;
+}
+
+// Only the last two rounds are kept, no journey is collected
+std::vector<double> Raptor::FindArrivals(size_t from, double max_weight) const {
+  if (from >= stop_count_) {
+    throw std::out_of_range("Stop index is out of range");
+  }
+  std::vector<double> previous(stop_count_, INFINITE_WEIGHT);
+  previous[from] = 0.;
+  std::vector<double> current = previous;
+  Scan scan(stop_count_, routes_.size(), from);
+  while (!scan.marked_stops.empty()) {
+    ScanRoutes(scan, previous, current, nullptr, NO_POSITION, max_weight);
+    previous = current;
+  }
+  return scan.best_arrivals;
+}
+
+Raptor::Scan::Scan(size_t stop_count, size_t route_count, size_t from)
+    : best_arrivals(stop_count, INFINITE_WEIGHT),
+      marked_stops{from},
+      is_marked(stop_count, false),
+      first_positions(route_count, NO_POSITION) {
+  best_arrivals[from] = 0.;
+}
+
+void Raptor::ScanRoutes(Scan& scan, const std::vector<double>& previous,
+                        std::vector<double>& current, std::vector<Leg>* legs,
+                        size_t to, double max_weight) const {
+  auto& best_arrivals = scan.best_arrivals;
+  // Every route is scanned once, from its first improved stop
+  for (const size_t stop : scan.marked_stops) {
+    scan.is_marked[stop] = false;
+    for (const auto& [route, position] : stop_routes_[stop]) {
+      if (scan.first_positions[route] == NO_POSITION) {
+        scan.marked_routes.push_back(route);
+      }
+      scan.first_positions[route] =
+          std::min(scan.first_positions[route], position);
+    }
+  }
+  scan.marked_stops.clear();
+
+  for (const size_t route : scan.marked_routes) {
+    const auto& stops = routes_[route].stops;
+    const auto& segment_times = routes_[route].segment_times;
+    // The ride is summed apart from the boarding time, so a journey's
+    // weight is exactly the sum of its items
+    size_t board_position = NO_POSITION;
+    double board_time = 0.;
+    double ride_time = 0.;
+    for (size_t position = scan.first_positions[route];
+         position < stops.size(); ++position) {
+      const size_t stop = stops[position];
+      if (board_position != NO_POSITION) {
+        const double arrival = board_time + ride_time;
+        if (arrival < best_arrivals[stop] && arrival <= max_weight &&
+            (to == NO_POSITION || arrival < best_arrivals[to])) {
+          best_arrivals[stop] = arrival;
+          current[stop] = arrival;
+          if (legs) {
+            (*legs)[stop] = {route, board_position, position, ride_time};
+          }
+          if (!scan.is_marked[stop]) {
+            scan.is_marked[stop] = true;
+            scan.marked_stops.push_back(stop);
+          }
+        }
+      }
+      if (position + 1 == stops.size()) {
+        break;
+      }
+      if (previous[stop] != INFINITE_WEIGHT) {
+        const double candidate = previous[stop] + boarding_time_;
+        if (board_position == NO_POSITION ||
+            candidate < board_time + ride_time) {
+          board_position = position;
+          board_time = candidate;
+          ride_time = 0.;
+        }
+      }
+      if (board_position != NO_POSITION) {
+        ride_time += segment_times[position];
+      }
+    }
+    scan.first_positions[route] = NO_POSITION;
+  }
+  scan.marked_routes.clear();
+}
+
+Journey Raptor::CollectJourney(const Rounds& rounds, size_t round,
+                               size_t from, size_t to) const {
+  Journey journey{rounds.arrivals[round][to], {}};
+  for (size_t stop = to; stop != from; --round) {
+    // An arrival is copied to the next rounds until one improves it
+    while (rounds.arrivals[round][stop] == rounds.arrivals[round - 1][stop]) {
+      --round;
+    }
+    const Leg& leg = rounds.legs[round][stop];
+    journey.legs.push_back(leg);
+    stop = routes_[leg.route].stops[leg.board_position];
+  }
+  std::reverse(journey.legs.begin(), journey.legs.end());
+  return journey;
+}
+
+}  // namespace raptor
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace raptor {
+
+// A bus as a sequence of stop indices. segment_times[i] is the ride from
+// stops[i] to stops[i + 1].
+struct Route {
+  std::vector<size_t> stops;
+  std::vector<double> segment_times;
+};
+
+// A ride along one route, from the stop at board_position to the stop at
+// alight_position
+struct Leg {
+  size_t route;
+  size_t board_position;
+  size_t alight_position;
+  double ride_time;
+};
+
+struct Journey {
+  double weight;
+  std::vector<Leg> legs;
+};
+
+// Round-based search over the routes themselves, without a graph. Round k
+// scans every route that serves a stop improved in round k - 1 and yields
+// the fastest journeys with at most k legs. Every boarding takes
+// boarding_time. A search scans its routes on the calling thread; searches
+// share nothing mutable, so separate ones may run in parallel.
+class Raptor {
+ public:
+  Raptor() = default;
+  Raptor(size_t stop_count, std::vector<Route> routes, double boarding_time);
+
+  const Route& GetRoute(size_t route) const;
+
+  std::optional<Journey> FindJourney(size_t from, size_t to) const;
+
+  // Pareto front by weight and number of legs: every journey is faster than
+  // the previous one and takes more legs. The last one is the fastest.
+  std::vector<Journey> FindParetoJourneys(size_t from, size_t to) const;
+
+  // Fastest arrival at every stop, infinity for the stops not reached within
+  // max_weight
+  std::vector<double> FindArrivals(
+      size_t from,
+      double max_weight = std::numeric_limits<double>::infinity()) const;
+
+ private:
+  // arrivals[k][stop] is the fastest arrival with at most k legs. legs[k][stop]
+  // is the last leg of that journey if round k improved it.
+  struct Rounds {
+    std::vector<std::vector<double>> arrivals;
+    std::vector<std::vector<Leg>> legs;
+  };
+
+  // Stops improved by the last round and the routes to scan from them
+  struct Scan {
+    Scan(size_t stop_count, size_t route_count, size_t from);
+
+    std::vector<double> best_arrivals;
+    std::vector<size_t> marked_stops;
+    std::vector<bool> is_marked;
+    std::vector<size_t> first_positions;
+    std::vector<size_t> marked_routes;
+  };
+
+  // One round: boards where the previous round arrived and records the
+  // improved arrivals in current, and their legs if legs is given. Arrivals
+  // above max_weight, or not faster than the best one at to, are dropped.
+  void ScanRoutes(Scan& scan, const std::vector<double>& previous,
+                  std::vector<double>& current, std::vector<Leg>* legs,
+                  size_t to, double max_weight) const;
+  Journey CollectJourney(const Rounds& rounds, size_t round, size_t from,
+                         size_t to) const;
+
+  size_t stop_count_ = 0;
+  std::vector<Route> routes_;
+  // (route, position) pairs of every stop
+  std::vector<std::vector<std::pair<size_t, size_t>>> stop_routes_;
+  double boarding_time_ = 0.;
+};
+
+}  // namespace raptor
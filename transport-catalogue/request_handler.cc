@@ -2,10 +2,13 @@
 
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "json.h"
 #include "json_builder.h"
+#include "thread_pool.h"
 
 namespace request_handler {
 
@@ -69,6 +72,44 @@ json::Node RequestHandler::ProcessBusRequest(const TrCat& cat,
   return bus.Build();
 }
 
+json::Node RequestHandler::ProcessRouteItems(
+    const TrRouter& transport_router,
+    const transport_router::RouteInfo& route_info) const {
+  using namespace std;
+  json::Builder route{};
+  route.StartArray();
+  int bus_wait_time = transport_router.GetBusWaitTime();
+  if (route_info.elements) {
+    for (const auto& element : route_info.elements.value()) {
+      if (std::holds_alternative<Wait>(element)) {
+        const auto& wait_element = get<Wait>(element);
+        route.StartDict()
+            .Key("type"s)
+            .Value("Wait"s)
+            .Key("stop_name"s)
+            .Value(move(string{wait_element.stop_name}))
+            .Key("time"s)
+            .Value(bus_wait_time)
+            .EndDict();
+      } else {
+        const auto& bus_element = std::get<Bus>(element);
+        route.StartDict()
+            .Key("type"s)
+            .Value("Bus"s)
+            .Key("bus"s)
+            .Value(move(string{bus_element.bus_name}))
+            .Key("span_count"s)
+            .Value(bus_element.span_count)
+            .Key("time"s)
+            .Value(bus_element.time)
+            .EndDict();
+      }
+    }
+  }
+  route.EndArray();
+  return route.Build();
+}
+
 json::Node RequestHandler::ProcessRouteRequest(
     const TrRouter& transport_router, const json::Node& request) const {
   using namespace std;
@@ -76,6 +117,37 @@ json::Node RequestHandler::ProcessRouteRequest(
   int id = request.AsDict().at("id"s).AsInt();
   const auto& from = request.AsDict().at("from"s).AsString();
   const auto& to = request.AsDict().at("to"s).AsString();
+  // Alternatives are asked for with "alternatives": true
+  const auto alternatives_it = request.AsDict().find("alternatives"s);
+  if (alternatives_it != request.AsDict().end() &&
+      alternatives_it->second.AsBool()) {
+    const auto alternatives =
+        transport_router.BuildRouteAlternatives(from, to);
+    if (alternatives.empty()) {
+      return ErrorMessage(id);
+    }
+    auto alternatives_array = route.StartDict()
+                                  .Key("request_id"s)
+                                  .Value(id)
+                                  .Key("total_time"s)
+                                  .Value(alternatives.back().weight)
+                                  .Key("items"s)
+                                  .Value(ProcessRouteItems(transport_router,
+                                                           alternatives.back())
+                                             .AsArray())
+                                  .Key("alternatives"s)
+                                  .StartArray();
+    for (const auto& alternative : alternatives) {
+      alternatives_array.StartDict()
+          .Key("total_time"s)
+          .Value(alternative.weight)
+          .Key("items"s)
+          .Value(ProcessRouteItems(transport_router, alternative).AsArray())
+          .EndDict();
+    }
+    alternatives_array.EndArray().EndDict();
+    return route.Build();
+  }
   auto route_info = transport_router.BuildRoute(from, to);
   if (route_info) {
     route.StartDict()
@@ -84,42 +156,76 @@ json::Node RequestHandler::ProcessRouteRequest(
         .Key("total_time"s)
         .Value(route_info->weight)
         .Key("items"s)
-        .StartArray();
-    int bus_wait_time = transport_router.GetBusWaitTime();
-    if (route_info->elements) {
-      for (const auto& element : route_info->elements.value()) {
-        if (std::holds_alternative<Wait>(element)) {
-          const auto& wait_element = get<Wait>(element);
-          route.StartDict()
-              .Key("type"s)
-              .Value("Wait"s)
-              .Key("stop_name"s)
-              .Value(move(string{wait_element.stop_name}))
-              .Key("time"s)
-              .Value(bus_wait_time)
-              .EndDict();
-        } else {
-          const auto& bus_element = std::get<Bus>(element);
-          route.StartDict()
-              .Key("type"s)
-              .Value("Bus"s)
-              .Key("bus"s)
-              .Value(move(string{bus_element.bus_name}))
-              .Key("span_count"s)
-              .Value(bus_element.span_count)
-              .Key("time"s)
-              .Value(bus_element.time)
-              .EndDict();
-        }
-      }
-    }
-    route.EndArray().EndDict();
+        .Value(ProcessRouteItems(transport_router, *route_info).AsArray())
+        .EndDict();
   } else {
     route.Value(ErrorMessage(id).AsDict());
   }
   return route.Build();
 }
 
+json::Node RequestHandler::ProcessRouteMatrixRequest(
+    const TrRouter& transport_router, const json::Node& request) const {
+  using namespace std;
+  int id = request.AsDict().at("id"s).AsInt();
+  vector<string_view> from;
+  for (const auto& stop_name : request.AsDict().at("from"s).AsArray()) {
+    from.push_back(stop_name.AsString());
+  }
+  vector<string_view> to;
+  for (const auto& stop_name : request.AsDict().at("to"s).AsArray()) {
+    to.push_back(stop_name.AsString());
+  }
+  const auto matrix = transport_router.BuildRouteMatrix(from, to);
+  json::Builder route_matrix{};
+  auto rows = route_matrix.StartDict()
+                  .Key("request_id"s)
+                  .Value(id)
+                  .Key("total_time"s)
+                  .StartArray();
+  for (const auto& row : matrix) {
+    auto row_array = rows.StartArray();
+    for (const auto& weight : row) {
+      if (weight) {
+        row_array.Value(*weight);
+      } else {
+        row_array.Value(nullptr);
+      }
+    }
+    row_array.EndArray();
+  }
+  rows.EndArray().EndDict();
+  return route_matrix.Build();
+}
+
+json::Node RequestHandler::ProcessIsochroneRequest(
+    const TrRouter& transport_router, const json::Node& request) const {
+  using namespace std;
+  int id = request.AsDict().at("id"s).AsInt();
+  const auto stops = transport_router.BuildIsochrone(
+      request.AsDict().at("from"s).AsString(),
+      request.AsDict().at("max_time"s).AsDouble());
+  if (!stops) {
+    return ErrorMessage(id);
+  }
+  json::Builder isochrone{};
+  auto stops_array = isochrone.StartDict()
+                         .Key("request_id"s)
+                         .Value(id)
+                         .Key("stops"s)
+                         .StartArray();
+  for (const auto& stop : *stops) {
+    stops_array.StartDict()
+        .Key("stop_name"s)
+        .Value(string{stop.stop_name})
+        .Key("time"s)
+        .Value(stop.time)
+        .EndDict();
+  }
+  stops_array.EndArray().EndDict();
+  return isochrone.Build();
+}
+
 json::Node RequestHandler::ProcessMapRequest(const TrCat& cat, MapRend& mr,
                                              const json::Node& request) const {
   using namespace std;
@@ -139,11 +245,29 @@ json::Node RequestHandler::ProcessMapRequest(const TrCat& cat, MapRend& mr,
 void RequestHandler::ProcessStatRequests(const TrCat& cat,
                                          const TrRouter& transport_router,
                                          MapRend& mr,
-                                         const json::Node& stat_requests) {
+                                         const json::Node& stat_requests,
+                                         size_t thread_count) {
   using namespace std;
+  const auto& requests = stat_requests.AsArray();
+  // Route requests only read the router, so they are answered on all the
+  // threads first and put in place below
+  vector<size_t> route_indices;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (requests[i].AsDict().at("type"s).AsString() == "Route"s) {
+      route_indices.push_back(i);
+    }
+  }
+  vector<json::Node> routes(route_indices.size());
+  thread_pool::ThreadPool pool(thread_count);
+  pool.ParallelFor(route_indices.size(), [&](size_t i) {
+    routes[i] =
+        ProcessRouteRequest(transport_router, requests[route_indices[i]]);
+  });
+
   json::Builder body{};
   auto body_array = body.StartArray();
-  for (const auto& request : stat_requests.AsArray()) {
+  size_t route_count = 0;
+  for (const auto& request : requests) {
     const auto& type = request.AsDict().at("type"s).AsString();
     if (type == "Stop"s) {
       body_array.Value(ProcessStopRequest(cat, request).AsDict());
@@ -152,7 +276,15 @@ void RequestHandler::ProcessStatRequests(const TrCat& cat,
       body_array.Value(ProcessBusRequest(cat, request).AsDict());
     }
     if (type == "Route"s) {
-      body_array.Value(ProcessRouteRequest(transport_router, request).AsDict());
+      body_array.Value(routes[route_count++].AsDict());
+    }
+    if (type == "RouteMatrix"s) {
+      body_array.Value(
+          ProcessRouteMatrixRequest(transport_router, request).AsDict());
+    }
+    if (type == "Isochrone"s) {
+      body_array.Value(
+          ProcessIsochroneRequest(transport_router, request).AsDict());
     }
     if (type == "Map"s) {
       body_array.Value(ProcessMapRequest(cat, mr, request).AsDict());
@@ -16,8 +16,11 @@ class RequestHandler {
   using Bus = transport_router::Bus;
 
  public:
+  // Route requests are answered on thread_count threads against the one
+  // router, the answers keep the order of the requests
   void ProcessStatRequests(const TrCat& cat, const TrRouter& tr_router,
-                           MapRend& mr, const json::Node& stat_reqs);
+                           MapRend& mr, const json::Node& stat_reqs,
+                           size_t thread_count = 1);
 
   void ProcessStatRequestsLite(const TrCat& cat, MapRend& mr,
                                const json::Node& stat_requests);
@@ -31,9 +34,19 @@ class RequestHandler {
   json::Node ProcessBusRequest(const TrCat& cat,
                                const json::Node& request) const;
 
+  json::Node ProcessRouteItems(const TrRouter& tr_router,
+                               const transport_router::RouteInfo& route_info)
+      const;
+
   json::Node ProcessRouteRequest(const TrRouter& tr_router,
                                  const json::Node& request) const;
 
+  json::Node ProcessRouteMatrixRequest(const TrRouter& tr_router,
+                                       const json::Node& request) const;
+
+  json::Node ProcessIsochroneRequest(const TrRouter& tr_router,
+                                     const json::Node& request) const;
+
   json::Node ProcessMapRequest(const TrCat& cat, MapRend& mr,
                                const json::Node& request) const;
 
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace transport_router {
+
+// Route weights are minutes. Built with FIXED_POINT_WEIGHTS they are integer
+// thousandths of a minute instead, and minutes are restored for the output
+// only.
+#ifdef FIXED_POINT_WEIGHTS
+using Weight = int32_t;
+inline constexpr double WEIGHT_UNITS_PER_MINUTE = 1000.;
+#else
+using Weight = double;
+inline constexpr double WEIGHT_UNITS_PER_MINUTE = 1.;
+#endif
+
+// Weight of no route: infinity, or the maximum of an integral weight
+inline constexpr Weight INFINITE_WEIGHT =
+    std::numeric_limits<Weight>::has_infinity
+        ? std::numeric_limits<Weight>::infinity()
+        : std::numeric_limits<Weight>::max();
+
+// Minutes out of the range of an integral weight saturate at its bounds,
+// too many of them give INFINITE_WEIGHT
+inline Weight ToWeight(double minutes) {
+  if constexpr (std::is_integral_v<Weight>) {
+    const double units = minutes * WEIGHT_UNITS_PER_MINUTE;
+    if (!(units < std::numeric_limits<Weight>::max())) {
+      return std::numeric_limits<Weight>::max();
+    }
+    if (units <= std::numeric_limits<Weight>::lowest()) {
+      return std::numeric_limits<Weight>::lowest();
+    }
+    return static_cast<Weight>(std::lround(units));
+  } else {
+    return minutes;
+  }
+}
+
+inline double ToMinutes(Weight weight) {
+  return weight / WEIGHT_UNITS_PER_MINUTE;
+}
+
+}  // namespace transport_router
@@ -3,25 +3,38 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <iterator>
+#include <limits>
 #include <optional>
+#include <queue>
 #include <stdexcept>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "graph.h"
+#include "min_plus.h"
+#include "search_scratch.h"
+#include "thread_pool.h"
 
 namespace graph {
 
+// Route queries are const and may run concurrently on one router: their
+// search state is kept per thread, see SearchScratch. Building or updating
+// the all-pairs table must not overlap with queries.
 template <typename Weight>
 class Router {
  private:
   using Graph = DirectedWeightedGraph<Weight>;
 
  public:
-  explicit Router(const Graph& graph);
-  explicit Router(const Graph& graph, bool);
+  // If precompute is false, the all-pairs table is not built and routes are
+  // searched on demand with Dijkstra's algorithm. Otherwise the table is
+  // computed by tiled Floyd-Warshall on thread_count threads
+  explicit Router(const Graph& graph, bool precompute = true,
+                  size_t thread_count = 1);
 
   struct RouteInfo {
     Weight weight;
@@ -29,105 +42,623 @@ class Router {
   };
 
   std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+  std::optional<RouteInfo> BuildRouteOnDemand(VertexId from,
+                                              VertexId to) const;
+  // heuristic(vertex) must not exceed the weight of the route from vertex
+  // to the destination
+  template <typename Heuristic>
+  std::optional<RouteInfo> BuildRouteAStar(VertexId from, VertexId to,
+                                           const Heuristic& heuristic) const;
+  // Requires reverse incidence lists of the graph
+  std::optional<RouteInfo> BuildRouteBidirectional(VertexId from,
+                                                   VertexId to) const;
+  // Weights of the routes from one vertex to each of targets, without the
+  // edges. A single search serves all the targets.
+  std::vector<std::optional<Weight>> BuildRouteWeights(
+      VertexId from, const std::vector<VertexId>& targets) const;
+
+  // Weights and last edges of the routes from one vertex, laid out as a row
+  // of the all-pairs table
+  struct RouteRow {
+    std::vector<Weight> weights;
+    std::vector<uint32_t> prev_edges;
+  };
+
+  // One Dijkstra's search for all the routes from the vertex
+  RouteRow BuildRouteRow(VertexId from) const;
+  std::optional<RouteInfo> BuildRoute(const RouteRow& row, VertexId to) const;
+  std::vector<std::optional<Weight>> BuildRouteWeights(
+      const RouteRow& row, const std::vector<VertexId>& targets) const;
+  // Weights of the routes from the vertex to every vertex, nullopt where the
+  // route weighs more than max_weight. The search stops at max_weight.
+  std::vector<std::optional<Weight>> BuildRouteWeightsWithin(
+      VertexId from, Weight max_weight) const;
+
+  static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+  // Computes the all-pairs table anew for the current graph
+  void PrecomputeRoutes(size_t thread_count = 1);
+  // Brings the all-pairs table up to date after the graph was rebuilt with
+  // the same vertices. new_edge_ids maps every edge of old_graph to the same
+  // edge of the graph, or to NO_EDGE if it was removed. Only the rows that
+  // may change are searched again. Does nothing without the table.
+  void UpdateRoutes(const Graph& old_graph,
+                    const std::vector<EdgeId>& new_edge_ids,
+                    size_t thread_count = 1);
 
   friend class serialization::Saver;
   friend class serialization::Loader;
 
  private:
-  struct RouteInternalData {
-    Weight weight;
-    std::optional<EdgeId> prev_edge;
-  };
+  // The all-pairs table is stored as two flat row-major V x V arrays.
+  // Missing routes and missing previous edges are marked with sentinels.
+  using PrevEdgeId = min_plus::PrevEdgeId;
+
+  static constexpr Weight ZERO_WEIGHT{};
+  static constexpr Weight INFINITE_WEIGHT =
+      std::numeric_limits<Weight>::has_infinity
+          ? std::numeric_limits<Weight>::infinity()
+          : std::numeric_limits<Weight>::max();
+  static constexpr PrevEdgeId NO_PREV_EDGE = min_plus::NO_PREV_EDGE;
+  static constexpr size_t TILE_SIZE = 64;
 
-  using RoutesInternalData =
-      std::vector<std::vector<std::optional<RouteInternalData>>>;
+  template <typename QueueItem>
+  using Scratch = SearchScratch<Weight, PrevEdgeId, QueueItem>;
 
+  size_t GetCell(VertexId from, VertexId to) const {
+    return from * graph_.GetVertexCount() + to;
+  }
 
   void InitializeRoutesInternalData(const Graph& graph) {
     const size_t vertex_count = graph.GetVertexCount();
+    if (graph.GetEdgeCount() >= NO_PREV_EDGE) {
+      throw std::length_error("Too many edges for the routing table");
+    }
+    route_weights_.assign(vertex_count * vertex_count, INFINITE_WEIGHT);
+    route_prev_edges_.assign(vertex_count * vertex_count, NO_PREV_EDGE);
     for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-      routes_internal_data_[vertex][vertex] =
-          RouteInternalData{ZERO_WEIGHT, std::nullopt};
+      route_weights_[GetCell(vertex, vertex)] = ZERO_WEIGHT;
       for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-        const auto& edge = graph.GetEdge(edge_id);
+        const auto edge = graph.GetEdge(edge_id);
         if (edge.weight < ZERO_WEIGHT) {
           throw std::domain_error("Edges' weights should be non-negative");
         }
-        auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-        if (!route_internal_data || route_internal_data->weight > edge.weight) {
-          route_internal_data = RouteInternalData{edge.weight, edge_id};
+        const size_t cell = GetCell(vertex, edge.to);
+        if (route_weights_[cell] == INFINITE_WEIGHT ||
+            route_weights_[cell] > edge.weight) {
+          route_weights_[cell] = edge.weight;
+          route_prev_edges_[cell] = static_cast<PrevEdgeId>(edge_id);
+        }
+      }
+    }
+  }
+
+  struct Tile {
+    VertexId begin;
+    VertexId end;
+  };
+
+  Tile GetTile(size_t vertex_count, size_t tile_index) const {
+    const VertexId begin = tile_index * TILE_SIZE;
+    return {begin, std::min(begin + TILE_SIZE, vertex_count)};
+  }
+
+  // Relaxes routes from the vertices of tile_from to the vertices of tile_to
+  // through every vertex of tile_through in ascending order. If the routes
+  // from tile_through do not change meanwhile, each row of tile_from is
+  // relaxed through all the vertices in turn while it stays in cache.
+  void RelaxTile(Tile tile_from, Tile tile_to, Tile tile_through) {
+    auto relax_row = [&](VertexId vertex_from, VertexId vertex_through) {
+      Weight* weights_from = &route_weights_[GetCell(vertex_from, 0)];
+      PrevEdgeId* prev_edges_from =
+          &route_prev_edges_[GetCell(vertex_from, 0)];
+      const Weight weight_from = weights_from[vertex_through];
+      if (weight_from == INFINITE_WEIGHT) {
+        return;
+      }
+      const size_t cell_through = GetCell(vertex_through, tile_to.begin);
+      min_plus::RelaxRow(weights_from + tile_to.begin,
+                         prev_edges_from + tile_to.begin,
+                         &route_weights_[cell_through],
+                         &route_prev_edges_[cell_through],
+                         tile_to.end - tile_to.begin, weight_from,
+                         prev_edges_from[vertex_through]);
+    };
+    if (tile_from.begin != tile_through.begin) {
+      for (VertexId vertex_from = tile_from.begin; vertex_from < tile_from.end;
+           ++vertex_from) {
+        for (VertexId vertex_through = tile_through.begin;
+             vertex_through < tile_through.end; ++vertex_through) {
+          relax_row(vertex_from, vertex_through);
+        }
+      }
+    } else {
+      for (VertexId vertex_through = tile_through.begin;
+           vertex_through < tile_through.end; ++vertex_through) {
+        for (VertexId vertex_from = tile_from.begin;
+             vertex_from < tile_from.end; ++vertex_from) {
+          relax_row(vertex_from, vertex_through);
         }
       }
     }
   }
 
-  void RelaxRoute(VertexId vertex_from, VertexId vertex_to,
-                  const RouteInternalData& route_from,
-                  const RouteInternalData& route_to) {
-    auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-    const Weight candidate_weight = route_from.weight + route_to.weight;
-    if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-      route_relaxing = {candidate_weight, route_to.prev_edge
-                                              ? route_to.prev_edge
-                                              : route_from.prev_edge};
+  // Blocked Floyd-Warshall: for every pivot tile the diagonal tile is
+  // relaxed first, then the tiles of the pivot row and column, then all the
+  // others. Tiles of one phase do not overlap and run in parallel, and each
+  // runs in a fixed order, so the table does not depend on the thread count.
+  // It may differ from the one of the plain triple loop: the other tiles
+  // take sums through a pivot row already relaxed through the whole pivot
+  // tile. Weights of doubles may then differ by rounding, and a route may
+  // be another of several equally light ones.
+  void RelaxRoutesInternalDataByTiles(size_t vertex_count,
+                                      thread_pool::ThreadPool& pool) {
+    const size_t tile_count = (vertex_count + TILE_SIZE - 1) / TILE_SIZE;
+    for (size_t pivot = 0; pivot < tile_count; ++pivot) {
+      const Tile tile_through = GetTile(vertex_count, pivot);
+      RelaxTile(tile_through, tile_through, tile_through);
+
+      pool.ParallelFor(2 * tile_count, [&](size_t task) {
+        const size_t other = task / 2;
+        if (other == pivot) {
+          return;
+        }
+        const Tile tile_other = GetTile(vertex_count, other);
+        if (task % 2 == 0) {
+          RelaxTile(tile_through, tile_other, tile_through);
+        } else {
+          RelaxTile(tile_other, tile_through, tile_through);
+        }
+      });
+
+      pool.ParallelFor(tile_count * tile_count, [&](size_t task) {
+        const size_t row = task / tile_count;
+        const size_t column = task % tile_count;
+        if (row == pivot || column == pivot) {
+          return;
+        }
+        RelaxTile(GetTile(vertex_count, row), GetTile(vertex_count, column),
+                  tile_through);
+      });
     }
   }
 
-  void RelaxRoutesInternalDataThroughVertex(size_t vertex_count,
-                                            VertexId vertex_through) {
-    for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-      if (const auto& route_from =
-              routes_internal_data_[vertex_from][vertex_through]) {
-        for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-          if (const auto& route_to =
-                  routes_internal_data_[vertex_through][vertex_to]) {
-            RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-          }
+  // Dijkstra's algorithm filling a row of V weights and previous edges. Only
+  // the weights up to max_weight are final, the search stops past it.
+  void SearchRoutesFrom(VertexId from, Weight* weights, PrevEdgeId* prev_edges,
+                        Weight max_weight = INFINITE_WEIGHT) const {
+    using QueueItem = std::pair<Weight, VertexId>;
+
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::fill(weights, weights + vertex_count, INFINITE_WEIGHT);
+    std::fill(prev_edges, prev_edges + vertex_count, NO_PREV_EDGE);
+    weights[from] = ZERO_WEIGHT;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>
+        queue;
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty()) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (weight > max_weight) {
+        break;
+      }
+      if (weight > weights[vertex]) {
+        continue;
+      }
+      for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+        const auto edge = graph_.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+          throw std::domain_error("Edges' weights should be non-negative");
+        }
+        const Weight candidate_weight = weight + edge.weight;
+        if (candidate_weight < weights[edge.to]) {
+          weights[edge.to] = candidate_weight;
+          prev_edges[edge.to] = static_cast<PrevEdgeId>(edge_id);
+          queue.push({candidate_weight, edge.to});
         }
       }
     }
   }
 
-  static constexpr Weight ZERO_WEIGHT{};
+  std::vector<EdgeId> CollectEdges(const PrevEdgeId* prev_edges,
+                                   PrevEdgeId last_edge) const {
+    std::vector<EdgeId> edges;
+    for (PrevEdgeId edge_id = last_edge; edge_id != NO_PREV_EDGE;
+         edge_id = prev_edges[graph_.GetEdge(edge_id).from]) {
+      edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    return edges;
+  }
+
   const Graph& graph_;
-  RoutesInternalData routes_internal_data_;
+  std::vector<Weight> route_weights_;
+  std::vector<PrevEdgeId> route_prev_edges_;
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
-    : graph_(graph),
-      routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(
-                                graph.GetVertexCount())) {
-  InitializeRoutesInternalData(graph);
-
-  const size_t vertex_count = graph.GetVertexCount();
-  for (VertexId vertex_through = 0; vertex_through < vertex_count;
-       ++vertex_through) {
-    RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+Router<Weight>::Router(const Graph& graph, bool precompute,
+                       size_t thread_count)
+    : graph_(graph) {
+  if (precompute) {
+    PrecomputeRoutes(thread_count);
   }
 }
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& g, bool) : graph_(g) {}
+void Router<Weight>::PrecomputeRoutes(size_t thread_count) {
+  InitializeRoutesInternalData(graph_);
+
+  thread_pool::ThreadPool pool(thread_count);
+  RelaxRoutesInternalDataByTiles(graph_.GetVertexCount(), pool);
+}
+
+// A row is searched again if its routes use an edge whose weight changed or
+// that was removed, or if a lighter or added edge shortens a route to the
+// head of the edge. Routes of the other rows stay the same, since no edge
+// can improve them, and only their edge ids are renumbered.
+template <typename Weight>
+void Router<Weight>::UpdateRoutes(const Graph& old_graph,
+                                  const std::vector<EdgeId>& new_edge_ids,
+                                  size_t thread_count) {
+  if (route_weights_.empty()) {
+    return;
+  }
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (old_graph.GetVertexCount() != vertex_count ||
+      new_edge_ids.size() != old_graph.GetEdgeCount()) {
+    throw std::invalid_argument("Graph vertices do not match the table");
+  }
+  if (graph_.GetEdgeCount() >= NO_PREV_EDGE) {
+    throw std::length_error("Too many edges for the routing table");
+  }
+
+  // Old ids of the changed edges, new ids of the lighter ones
+  std::vector<EdgeId> changed_edges;
+  std::vector<EdgeId> lighter_edges;
+  std::vector<bool> is_matched(graph_.GetEdgeCount(), false);
+  for (EdgeId edge_id = 0; edge_id < new_edge_ids.size(); ++edge_id) {
+    const EdgeId new_edge_id = new_edge_ids[edge_id];
+    if (new_edge_id == NO_EDGE) {
+      changed_edges.push_back(edge_id);
+      continue;
+    }
+    is_matched.at(new_edge_id) = true;
+    const Weight old_weight = old_graph.GetEdge(edge_id).weight;
+    const Weight new_weight = graph_.GetEdge(new_edge_id).weight;
+    if (new_weight != old_weight) {
+      changed_edges.push_back(edge_id);
+    }
+    if (new_weight < old_weight) {
+      lighter_edges.push_back(new_edge_id);
+    }
+  }
+  for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    if (graph_.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+      throw std::domain_error("Edges' weights should be non-negative");
+    }
+    if (!is_matched[edge_id]) {
+      lighter_edges.push_back(edge_id);
+    }
+  }
+
+  thread_pool::ThreadPool pool(thread_count);
+  pool.ParallelFor(vertex_count, [&](size_t from) {
+    const Weight* weights = &route_weights_[GetCell(from, 0)];
+    PrevEdgeId* prev_edges = &route_prev_edges_[GetCell(from, 0)];
+    const auto uses_edge = [&](EdgeId edge_id) {
+      return prev_edges[old_graph.GetEdge(edge_id).to] == edge_id;
+    };
+    const auto is_shortened_by = [&](EdgeId edge_id) {
+      const auto edge = graph_.GetEdge(edge_id);
+      return weights[edge.from] != INFINITE_WEIGHT &&
+             weights[edge.from] + edge.weight < weights[edge.to];
+    };
+    if (std::any_of(changed_edges.begin(), changed_edges.end(), uses_edge) ||
+        std::any_of(lighter_edges.begin(), lighter_edges.end(),
+                    is_shortened_by)) {
+      SearchRoutesFrom(from, &route_weights_[GetCell(from, 0)], prev_edges);
+      return;
+    }
+    for (VertexId to = 0; to < vertex_count; ++to) {
+      if (prev_edges[to] != NO_PREV_EDGE) {
+        prev_edges[to] = static_cast<PrevEdgeId>(new_edge_ids[prev_edges[to]]);
+      }
+    }
+  });
+}
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(
     VertexId from, VertexId to) const {
-  const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-  if (!route_internal_data) {
+  if (route_weights_.empty()) {
+    return BuildRouteOnDemand(from, to);
+  }
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count || to >= vertex_count) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  const Weight weight = route_weights_[GetCell(from, to)];
+  if (weight == INFINITE_WEIGHT) {
     return std::nullopt;
   }
-  const Weight weight = route_internal_data->weight;
-  std::vector<EdgeId> edges;
-  for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge; edge_id;
-       edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]
-                     ->prev_edge) {
-    edges.push_back(*edge_id);
+  return RouteInfo{weight,
+                   CollectEdges(&route_prev_edges_[GetCell(from, 0)],
+                                route_prev_edges_[GetCell(from, to)])};
+}
+
+template <typename Weight>
+typename Router<Weight>::RouteRow Router<Weight>::BuildRouteRow(
+    VertexId from) const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  if (graph_.GetEdgeCount() >= NO_PREV_EDGE) {
+    throw std::length_error("Too many edges for the routing table");
   }
-  std::reverse(edges.begin(), edges.end());
+  RouteRow row{std::vector<Weight>(vertex_count),
+               std::vector<PrevEdgeId>(vertex_count)};
+  SearchRoutesFrom(from, row.weights.data(), row.prev_edges.data());
+  return row;
+}
 
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(
+    const RouteRow& row, VertexId to) const {
+  if (to >= row.weights.size()) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  if (row.weights[to] == INFINITE_WEIGHT) {
+    return std::nullopt;
+  }
+  return RouteInfo{row.weights[to],
+                   CollectEdges(row.prev_edges.data(), row.prev_edges[to])};
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo>
+Router<Weight>::BuildRouteOnDemand(VertexId from, VertexId to) const {
+  return BuildRouteAStar(from, to, [](VertexId) { return ZERO_WEIGHT; });
+}
+
+template <typename Weight>
+template <typename Heuristic>
+std::optional<typename Router<Weight>::RouteInfo>
+Router<Weight>::BuildRouteAStar(VertexId from, VertexId to,
+                                const Heuristic& heuristic) const {
+  // Vertices are popped by weight plus heuristic. An improved vertex is
+  // pushed again, so an admissible heuristic is enough for optimality. The
+  // heuristic is called once per reached vertex, its value is kept as the
+  // vertex's key.
+  using QueueItem = std::tuple<Weight, Weight, VertexId>;
+
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count || to >= vertex_count) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  auto& search = Scratch<QueueItem>::Acquire(vertex_count);
+  search.Set(from, ZERO_WEIGHT, NO_PREV_EDGE);
+  search.SetKey(from, heuristic(from));
+  search.Push({search.GetKey(from), ZERO_WEIGHT, from});
+  while (!search.IsQueueEmpty()) {
+    const auto [estimate, weight, vertex] = search.Top();
+    search.Pop();
+    if (weight > search.GetWeight(vertex)) {
+      continue;
+    }
+    if (vertex == to) {
+      break;
+    }
+    for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+      const auto edge = graph_.GetEdge(edge_id);
+      if (edge.weight < ZERO_WEIGHT) {
+        throw std::domain_error("Edges' weights should be non-negative");
+      }
+      const Weight candidate_weight = weight + edge.weight;
+      const Weight current_weight = search.GetWeight(edge.to);
+      if (candidate_weight < current_weight) {
+        search.Set(edge.to, candidate_weight,
+                   static_cast<PrevEdgeId>(edge_id));
+        if (current_weight == INFINITE_WEIGHT) {
+          search.SetKey(edge.to, heuristic(edge.to));
+        }
+        search.Push({candidate_weight + search.GetKey(edge.to),
+                     candidate_weight, edge.to});
+      }
+    }
+  }
+
+  if (search.GetWeight(to) == INFINITE_WEIGHT) {
+    return std::nullopt;
+  }
+  return RouteInfo{search.GetWeight(to),
+                   CollectEdges(search.GetEdges(), search.GetEdge(to))};
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> Router<Weight>::BuildRouteWeights(
+    VertexId from, const std::vector<VertexId>& targets) const {
+  using QueueItem = std::pair<Weight, VertexId>;
+
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count ||
+      std::any_of(targets.begin(), targets.end(),
+                  [vertex_count](VertexId to) { return to >= vertex_count; })) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  std::vector<Weight> weights;
+  if (!route_weights_.empty()) {
+    const Weight* row = &route_weights_[GetCell(from, 0)];
+    weights.assign(row, row + vertex_count);
+  } else {
+    // Dijkstra's search stops once every target is settled
+    std::vector<bool> is_target(vertex_count, false);
+    size_t targets_left = 0;
+    for (const VertexId to : targets) {
+      if (!is_target[to]) {
+        is_target[to] = true;
+        ++targets_left;
+      }
+    }
+    weights.assign(vertex_count, INFINITE_WEIGHT);
+    weights[from] = ZERO_WEIGHT;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>
+        queue;
+    queue.push({ZERO_WEIGHT, from});
+    while (!queue.empty() && targets_left > 0) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (weight > weights[vertex]) {
+        continue;
+      }
+      if (is_target[vertex]) {
+        --targets_left;
+      }
+      for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+        const auto edge = graph_.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+          throw std::domain_error("Edges' weights should be non-negative");
+        }
+        const Weight candidate_weight = weight + edge.weight;
+        if (candidate_weight < weights[edge.to]) {
+          weights[edge.to] = candidate_weight;
+          queue.push({candidate_weight, edge.to});
+        }
+      }
+    }
+  }
+
+  return BuildRouteWeights(RouteRow{std::move(weights), {}}, targets);
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> Router<Weight>::BuildRouteWeights(
+    const RouteRow& row, const std::vector<VertexId>& targets) const {
+  std::vector<std::optional<Weight>> result;
+  result.reserve(targets.size());
+  for (const VertexId to : targets) {
+    if (row.weights.at(to) == INFINITE_WEIGHT) {
+      result.push_back(std::nullopt);
+    } else {
+      result.push_back(row.weights[to]);
+    }
+  }
+  return result;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> Router<Weight>::BuildRouteWeightsWithin(
+    VertexId from, Weight max_weight) const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  std::vector<Weight> weights(vertex_count);
+  std::vector<PrevEdgeId> prev_edges(vertex_count);
+  SearchRoutesFrom(from, weights.data(), prev_edges.data(), max_weight);
+  std::vector<std::optional<Weight>> result(vertex_count);
+  for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+    if (weights[vertex] <= max_weight && weights[vertex] != INFINITE_WEIGHT) {
+      result[vertex] = weights[vertex];
+    }
+  }
+  return result;
+}
+
+template <typename Weight>
+std::optional<typename Router<Weight>::RouteInfo>
+Router<Weight>::BuildRouteBidirectional(VertexId from, VertexId to) const {
+  // Forward search from the source along outgoing edges and backward search
+  // from the destination along incoming ones. The side with the smaller
+  // radius is expanded; the searches stop once the radii sum reaches the
+  // best route seen where they meet.
+  using QueueItem = std::pair<Weight, VertexId>;
+
+  const size_t vertex_count = graph_.GetVertexCount();
+  if (from >= vertex_count || to >= vertex_count) {
+    throw std::out_of_range("Vertex id is out of range");
+  }
+  if (!graph_.HasReverseIncidenceLists()) {
+    throw std::logic_error("Bidirectional search needs reverse edges");
+  }
+  auto& forward = Scratch<QueueItem>::Acquire(vertex_count, 0);
+  auto& backward = Scratch<QueueItem>::Acquire(vertex_count, 1);
+  forward.Set(from, ZERO_WEIGHT, NO_PREV_EDGE);
+  backward.Set(to, ZERO_WEIGHT, NO_PREV_EDGE);
+  forward.Push({ZERO_WEIGHT, from});
+  backward.Push({ZERO_WEIGHT, to});
+
+  Weight best_weight = from == to ? ZERO_WEIGHT : INFINITE_WEIGHT;
+  VertexId meeting_vertex = from;
+
+  // Incident and incoming edges are different ranges, hence the generic
+  // lambda. The forward search keeps previous edges, the backward one the
+  // next edges.
+  const auto relax = [&](bool is_forward, Weight weight,
+                         const auto& edge_ids) {
+    auto& search = is_forward ? forward : backward;
+    const auto& other = is_forward ? backward : forward;
+    for (const EdgeId edge_id : edge_ids) {
+      const auto edge = graph_.GetEdge(edge_id);
+      if (edge.weight < ZERO_WEIGHT) {
+        throw std::domain_error("Edges' weights should be non-negative");
+      }
+      const VertexId next_vertex = is_forward ? edge.to : edge.from;
+      const Weight candidate_weight = weight + edge.weight;
+      if (candidate_weight < search.GetWeight(next_vertex)) {
+        search.Set(next_vertex, candidate_weight,
+                   static_cast<PrevEdgeId>(edge_id));
+        search.Push({candidate_weight, next_vertex});
+      }
+      if (other.GetWeight(next_vertex) != INFINITE_WEIGHT &&
+          search.GetWeight(next_vertex) + other.GetWeight(next_vertex) <
+              best_weight) {
+        best_weight =
+            search.GetWeight(next_vertex) + other.GetWeight(next_vertex);
+        meeting_vertex = next_vertex;
+      }
+    }
+  };
+
+  while (!forward.IsQueueEmpty() && !backward.IsQueueEmpty()) {
+    const Weight forward_radius = forward.Top().first;
+    const Weight backward_radius = backward.Top().first;
+    if (best_weight != INFINITE_WEIGHT &&
+        forward_radius + backward_radius >= best_weight) {
+      break;
+    }
+    if (forward_radius <= backward_radius) {
+      const auto [weight, vertex] = forward.Top();
+      forward.Pop();
+      if (weight <= forward.GetWeight(vertex)) {
+        relax(true, weight, graph_.GetIncidentEdges(vertex));
+      }
+    } else {
+      const auto [weight, vertex] = backward.Top();
+      backward.Pop();
+      if (weight <= backward.GetWeight(vertex)) {
+        relax(false, weight, graph_.GetIncomingEdges(vertex));
+      }
+    }
+  }
+
+  if (best_weight == INFINITE_WEIGHT) {
+    return std::nullopt;
+  }
+  std::vector<EdgeId> edges =
+      CollectEdges(forward.GetEdges(), forward.GetEdge(meeting_vertex));
+  for (PrevEdgeId edge_id = backward.GetEdge(meeting_vertex);
+       edge_id != NO_PREV_EDGE;
+       edge_id = backward.GetEdge(graph_.GetEdge(edge_id).to)) {
+    edges.push_back(edge_id);
+  }
+  // Summed in route order, the weight does not depend on the meeting vertex
+  Weight weight = ZERO_WEIGHT;
+  for (const EdgeId edge_id : edges) {
+    weight += graph_.GetEdge(edge_id).weight;
+  }
   return RouteInfo{weight, std::move(edges)};
 }
 
-}  // namespace graph
\ No newline at end of file
+}  // namespace graph
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "graph.h"
+
+namespace graph {
+
+// Per-vertex state and priority queue of a Dijkstra-like search, kept by the
+// thread between its searches. Only the vertices the previous search reached
+// are reset, so a query allocates nothing and makes no pass over all the
+// vertices. Searches on different threads never share a scratch.
+template <typename Weight, typename SearchEdgeId, typename QueueItem>
+class SearchScratch {
+ public:
+  static constexpr Weight INFINITE_WEIGHT =
+      std::numeric_limits<Weight>::has_infinity
+          ? std::numeric_limits<Weight>::infinity()
+          : std::numeric_limits<Weight>::max();
+  static constexpr SearchEdgeId NO_SEARCH_EDGE =
+      std::numeric_limits<SearchEdgeId>::max();
+
+  // The calling thread's scratch number index, clean and large enough for
+  // vertex_count vertices. A search needing two at once takes 0 and 1.
+  static SearchScratch& Acquire(size_t vertex_count, size_t index = 0) {
+    static thread_local SearchScratch scratches[2];
+    SearchScratch& scratch = scratches[index];
+    scratch.Clear(vertex_count);
+    return scratch;
+  }
+
+  Weight GetWeight(VertexId vertex) const { return weights_[vertex]; }
+  SearchEdgeId GetEdge(VertexId vertex) const { return edges_[vertex]; }
+  const SearchEdgeId* GetEdges() const { return edges_.data(); }
+
+  void Set(VertexId vertex, Weight weight, SearchEdgeId edge) {
+    if (weights_[vertex] == INFINITE_WEIGHT) {
+      touched_.push_back(vertex);
+    }
+    weights_[vertex] = weight;
+    edges_[vertex] = edge;
+  }
+
+  // Extra weight per reached vertex, INFINITE_WEIGHT until set
+  Weight GetKey(VertexId vertex) const { return keys_[vertex]; }
+  void SetKey(VertexId vertex, Weight key) { keys_[vertex] = key; }
+
+  // Lightest item first
+  bool IsQueueEmpty() const { return queue_.empty(); }
+  const QueueItem& Top() const { return queue_.front(); }
+  void Push(const QueueItem& item) {
+    queue_.push_back(item);
+    std::push_heap(queue_.begin(), queue_.end(), std::greater<>{});
+  }
+  void Pop() {
+    std::pop_heap(queue_.begin(), queue_.end(), std::greater<>{});
+    queue_.pop_back();
+  }
+
+ private:
+  // A search that threw leaves its vertices to the next Clear
+  void Clear(size_t vertex_count) {
+    for (const VertexId vertex : touched_) {
+      weights_[vertex] = INFINITE_WEIGHT;
+      edges_[vertex] = NO_SEARCH_EDGE;
+      keys_[vertex] = INFINITE_WEIGHT;
+    }
+    touched_.clear();
+    queue_.clear();
+    if (weights_.size() < vertex_count) {
+      weights_.resize(vertex_count, INFINITE_WEIGHT);
+      edges_.resize(vertex_count, NO_SEARCH_EDGE);
+      keys_.resize(vertex_count, INFINITE_WEIGHT);
+    }
+  }
+
+  std::vector<Weight> weights_;
+  std::vector<SearchEdgeId> edges_;
+  std::vector<Weight> keys_;
+  std::vector<VertexId> touched_;
+  std::vector<QueueItem> queue_;
+};
+
+}  // namespace graph
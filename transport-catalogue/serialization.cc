@@ -2,11 +2,19 @@
 
 #include <transport_catalogue.pb.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include "graph.h"
 #include "json_reader.h"
+#include "lru_cache.h"
 #include "map_renderer.h"
 #include "request_handler.h"
 #include "svg.h"
@@ -17,8 +25,47 @@ namespace serialization {
 
 using JSONrr = json_reader::JSONreader;
 using ReqHand = request_handler::RequestHandler;
-using Wait = transport_router::Wait;
-using Bus = transport_router::Bus;
+using transport_router::Weight;
+
+namespace {
+
+using DoubleField = google::protobuf::RepeatedField<double>;
+using FixedField = google::protobuf::RepeatedField<int32_t>;
+
+// Weights go to the field of their type, so a base is read only by a build
+// with the same weight type
+template <typename Iterator>
+void SaveWeights(Iterator begin, Iterator end, DoubleField* weights,
+                 FixedField* fixed_weights) {
+  if constexpr (std::is_integral_v<Weight>) {
+    fixed_weights->Add(begin, end);
+  } else {
+    weights->Add(begin, end);
+  }
+}
+
+std::vector<Weight> LoadWeights(const DoubleField& weights,
+                                const FixedField& fixed_weights) {
+  if constexpr (std::is_integral_v<Weight>) {
+    if (!weights.empty()) {
+      throw std::invalid_argument("Base was built with double weights.");
+    }
+    return {fixed_weights.begin(), fixed_weights.end()};
+  } else {
+    if (!fixed_weights.empty()) {
+      throw std::invalid_argument("Base was built with fixed-point weights.");
+    }
+    return {weights.begin(), weights.end()};
+  }
+}
+
+void PrintCacheStats(std::string_view cache_name,
+                     const lru_cache::CacheStats& stats, std::ostream& out) {
+  out << cache_name << " cache: " << stats.hits << " hits, " << stats.misses
+      << " misses\n";
+}
+
+}  // namespace
 
 Saver::Saver(SerSettings s, const TrCat& tc, const TrRouter& tr)
     : cat_(tc), tr_router_(tr), settings_(std::move(s)) {}
@@ -27,7 +74,7 @@ void Saver::SaveTrCat() {
   for (const auto& stop : cat_.stops_) {
     auto serial_stop = base_proto_.add_stop();
     serial_stop->set_id(stop.id);
-    serial_stop->set_name(stop.name);
+    serial_stop->set_name(stop.name.data(), stop.name.size());
     serial_stop->mutable_coordinates()->set_lat(stop.coordinates.lat);
     serial_stop->mutable_coordinates()->set_lng(stop.coordinates.lng);
     serial_stop->set_is_consistent(stop.is_consistent);
@@ -35,16 +82,24 @@ void Saver::SaveTrCat() {
   for (const auto& bus : cat_.buses_) {
     auto serial_bus = base_proto_.add_bus();
     serial_bus->set_id(bus.id);
-    serial_bus->set_name(bus.name);
+    serial_bus->set_name(bus.name.data(), bus.name.size());
     serial_bus->set_is_roundtrip(bus.is_roundtrip);
-    for (auto stop : bus.stops) {
-      serial_bus->add_stop_id(stop->id);
+    for (const auto stop_id : bus.stops) {
+      serial_bus->add_stop_id(stop_id);
+    }
+    if (cat_.is_finalized_) {
+      serial_bus->set_route_length(bus.stats.route_length);
+      serial_bus->set_curvature(bus.stats.curvature);
     }
   }
-  for (const auto& [key, val] : cat_.distances_) {
-    auto serial_dist = base_proto_.add_distance();
-    serial_dist->set_key(key);
-    serial_dist->set_val(val);
+  base_proto_.set_is_finalized(cat_.is_finalized_);
+  for (const auto& stop : cat_.stops_) {
+    for (const auto& [to_id, val] : stop.distances) {
+      auto serial_dist = base_proto_.add_distance();
+      serial_dist->set_from_stop_id(stop.id);
+      serial_dist->set_to_stop_id(to_id);
+      serial_dist->set_val(val);
+    }
   }
 }
 
@@ -78,74 +133,140 @@ void Saver::SaveVertexMap(TrRoutProto* router_proto) {
   }
 }
 
-void Saver::SaveEdgeMap(TrRoutProto* router_proto) {
-  const auto& edge_map = tr_router_.edge_id_to_route_element_;
-  for (const auto& [key, val] : edge_map) {
-    auto edge_map = router_proto->add_edge_id_to_route_element();
-    edge_map->set_key(key);
-    if (std::holds_alternative<Wait>(val)) {
-      const auto& wait_val = std::get<Wait>(val);
-      edge_map->set_stop_id(cat_.stopname_to_stop_.at(wait_val.stop_name)->id);
-    }
-    if (std::holds_alternative<Bus>(val)) {
-      const auto& bus_val = std::get<Bus>(val);
-      auto bus = edge_map->mutable_bus();
-      bus->set_bus_id(cat_.busname_to_bus_.at(bus_val.bus_name)->id);
-      bus->set_span_count(bus_val.span_count);
-      bus->set_time(bus_val.time);
-    }
+void Saver::SaveEdgeTable(TrRoutProto* router_proto) {
+  for (const auto& stop_name : tr_router_.stop_names_) {
+    router_proto->add_stop_id(cat_.stopname_to_stop_.at(stop_name)->id);
+  }
+  for (const auto& bus_name : tr_router_.bus_names_) {
+    router_proto->add_bus_id(cat_.busname_to_bus_.at(bus_name)->id);
+  }
+  auto table_pr = router_proto->mutable_edge_table();
+  for (const auto& info : tr_router_.edge_infos_) {
+    table_pr->add_kind(static_cast<uint32_t>(info.kind));
+    table_pr->add_element_id(info.element_id);
+    table_pr->add_span_count(info.span_count);
   }
 }
 
 void Saver::SaveGraph(TrRoutProto* router_proto) {
   auto graph_proto = router_proto->mutable_graph();
-  for (const auto& [from, to, weight] : tr_router_.graph_.edges_) {
-    auto edge = graph_proto->add_edges();
-    edge->set_from(from);
-    edge->set_to(to);
-    edge->set_weight(weight);
-  }
-  for (const auto& inc_list : tr_router_.graph_.incidence_lists_) {
-    auto inc_list_pr = graph_proto->add_incidence_lists();
-    for (const auto& edge_id : inc_list) {
-      inc_list_pr->add_edge_id(edge_id);
-    }
-  }
+  const auto& graph = tr_router_.graph_;
+  graph_proto->mutable_offsets()->Add(graph.offsets_.begin(),
+                                      graph.offsets_.end());
+  graph_proto->mutable_targets()->Add(graph.targets_.begin(),
+                                      graph.targets_.end());
+  SaveWeights(graph.weights_.begin(), graph.weights_.end(),
+              graph_proto->mutable_weights(),
+              graph_proto->mutable_fixed_weights());
 }
 
 void Saver::SaveRouter(TrRoutProto* router_proto) {
   auto router_lib_pr = router_proto->mutable_router();
-  for (const auto& vec_rid : tr_router_.router_.routes_internal_data_) {
-    auto rep_rep_rid = router_lib_pr->add_repreprid();
-    for (const auto& rid : vec_rid) {
-      auto rep_rid = rep_rep_rid->add_reprid();
-      if (rid) {
-        rep_rid->set_weight(rid->weight);
-        if (rid->prev_edge) {
-          rep_rid->set_prev_edge(*rid->prev_edge);
-        }
-      }
+  const auto& router = tr_router_.router_;
+  SaveWeights(router.route_weights_.begin(), router.route_weights_.end(),
+              router_lib_pr->mutable_route_weight(),
+              router_lib_pr->mutable_route_fixed_weight());
+  router_lib_pr->mutable_route_prev_edge()->Add(
+      router.route_prev_edges_.begin(), router.route_prev_edges_.end());
+}
+
+void Saver::SaveContractionHierarchy(TrRoutProto* router_proto) {
+  const auto& ch = tr_router_.contraction_hierarchy_;
+  if (ch.ranks_.empty()) {
+    return;
+  }
+  auto ch_pr = router_proto->mutable_contraction_hierarchy();
+  ch_pr->mutable_rank()->Add(ch.ranks_.begin(), ch.ranks_.end());
+  for (const auto& shortcut : ch.shortcuts_) {
+    auto shortcut_pr = ch_pr->add_shortcuts();
+    shortcut_pr->set_from(shortcut.from);
+    shortcut_pr->set_to(shortcut.to);
+    if constexpr (std::is_integral_v<Weight>) {
+      shortcut_pr->set_fixed_weight(shortcut.weight);
+    } else {
+      shortcut_pr->set_weight(shortcut.weight);
     }
+    shortcut_pr->set_first_edge(shortcut.first_edge);
+    shortcut_pr->set_second_edge(shortcut.second_edge);
   }
 }
 
+void Saver::SaveHubLabels(TrRoutProto* router_proto) {
+  const auto& hub_labels = tr_router_.hub_labels_;
+  if (hub_labels.out_labels_.offsets.empty()) {
+    return;
+  }
+  auto save_labels = [](const auto& labels, protobuf::Labels* labels_pr) {
+    labels_pr->mutable_offsets()->Add(labels.offsets.begin(),
+                                      labels.offsets.end());
+    std::vector<Weight> weights;
+    weights.reserve(labels.labels.size());
+    for (const auto& label : labels.labels) {
+      labels_pr->add_hub(label.hub);
+      weights.push_back(label.weight);
+      labels_pr->add_edge(label.edge);
+    }
+    SaveWeights(weights.begin(), weights.end(), labels_pr->mutable_weight(),
+                labels_pr->mutable_fixed_weight());
+  };
+  auto hub_labels_pr = router_proto->mutable_hub_labels();
+  save_labels(hub_labels.out_labels_, hub_labels_pr->mutable_out_labels());
+  save_labels(hub_labels.in_labels_, hub_labels_pr->mutable_in_labels());
+}
+
 void Saver::SaveTrRouter() {
   auto router_proto = base_proto_.mutable_router();
   auto router_sett = router_proto->mutable_settings();
   router_sett->set_bus_wait_time(tr_router_.routing_settings_.bus_wait_time);
   router_sett->set_bus_velocity(tr_router_.routing_settings_.bus_velocity);
-  SaveVertexMap(router_proto);
-  SaveEdgeMap(router_proto);
-  SaveGraph(router_proto);
+  router_sett->set_router_mode(static_cast<protobuf::RouterMode>(
+      tr_router_.routing_settings_.router_mode));
+  router_sett->set_route_cache_size(
+      tr_router_.routing_settings_.route_cache_size);
+  router_sett->set_graph_model(static_cast<protobuf::GraphModel>(
+      tr_router_.routing_settings_.graph_model));
+  router_sett->set_row_cache_size(tr_router_.routing_settings_.row_cache_size);
+  router_sett->set_save_route_rows(
+      tr_router_.routing_settings_.save_route_rows);
+  // The raptor mode keeps no graph, its vertices are the stops in order
+  if (tr_router_.routing_settings_.router_mode !=
+      transport_router::RouterMode::RAPTOR) {
+    SaveVertexMap(router_proto);
+    SaveGraph(router_proto);
+  }
+  SaveEdgeTable(router_proto);
   SaveRouter(router_proto);
+  SaveContractionHierarchy(router_proto);
+  SaveHubLabels(router_proto);
+  SaveRouteRows(router_proto);
 }
 
+void Saver::SaveRouteRows(TrRoutProto* router_proto) {
+  for (const auto& [from, route_row] : tr_router_.row_cache_.GetEntries()) {
+    auto row_pr = router_proto->add_route_rows();
+    row_pr->set_from(from);
+    SaveWeights(route_row->weights.begin(), route_row->weights.end(),
+                row_pr->mutable_weight(), row_pr->mutable_fixed_weight());
+    row_pr->mutable_prev_edge()->Add(route_row->prev_edges.begin(),
+                                     route_row->prev_edges.end());
+  }
+}
+
+// The base is written next to the file and renamed over it, so a reader or
+// a failed write never sees a partly written base
 bool Saver::Write() const {
-  std::ofstream out_file(settings_.file, std::ios::binary);
+  const std::string temp_file = settings_.file + ".tmp";
+  std::ofstream out_file(temp_file, std::ios::binary);
   if (!out_file) {
     return false;
   }
-  return base_proto_.SerializeToOstream(&out_file);
+  const bool is_written = base_proto_.SerializeToOstream(&out_file);
+  out_file.close();
+  if (!is_written || !out_file) {
+    std::remove(temp_file.c_str());
+    return false;
+  }
+  return std::rename(temp_file.c_str(), settings_.file.c_str()) == 0;
 }
 
 void Saver::SaveColor(protobuf::Color* color_proto,
@@ -179,10 +300,20 @@ Loader::Loader(SerSettings s) : settings_(std::move(s)) {}
 
 TrCat Loader::LoadTrCat() const {
   TrCat cat;
+  // All the names go to one block of the pool and fit its table as it is
+  size_t names_size = 0;
+  for (const auto& s : base_proto_.stop()) {
+    names_size += s.name().size();
+  }
+  for (const auto& b : base_proto_.bus()) {
+    names_size += b.name().size();
+  }
+  cat.names_.Reserve(base_proto_.stop_size() + base_proto_.bus_size(),
+                     names_size);
   for (const auto& s : base_proto_.stop()) {
     auto& stop = cat.stops_.emplace_back(TrCat::Stop{});
     stop.id = s.id();
-    stop.name = s.name();
+    stop.name = cat.names_.Intern(s.name());
     stop.coordinates.lat = s.coordinates().lat();
     stop.coordinates.lng = s.coordinates().lng();
     stop.is_consistent = s.is_consistent();
@@ -191,17 +322,29 @@ TrCat Loader::LoadTrCat() const {
   for (const auto& b : base_proto_.bus()) {
     auto& bus = cat.buses_.emplace_back(TrCat::Bus{});
     bus.id = b.id();
-    bus.name = b.name();
+    bus.name = cat.names_.Intern(b.name());
     for (const auto& id : b.stop_id()) {
-      bus.stops.push_back(&cat.stops_[id]);
-      bus.unique_stops.insert(&cat.stops_[id]);
-      cat.stops_[id].buses.insert(bus.name);
+      bus.stops.push_back(id);
     }
     bus.is_roundtrip = b.is_roundtrip();
+    bus.stats = {b.route_length(), b.curvature()};
     cat.busname_to_bus_[bus.name] = &bus;
   }
+  const int stop_count = static_cast<int>(cat.stops_.size());
   for (const auto& d : base_proto_.distance()) {
-    cat.distances_[d.key()] = d.val();
+    if (d.from_stop_id() < 0 || d.from_stop_id() >= stop_count ||
+        d.to_stop_id() < 0 || d.to_stop_id() >= stop_count) {
+      throw std::invalid_argument("Invalid deserialized distance data.");
+    }
+    TrCat::SetStopDistance(cat.stops_[d.from_stop_id()], d.to_stop_id(),
+                           d.val());
+  }
+  // The stored statistics are kept, only the indexes are rebuilt
+  if (base_proto_.is_finalized()) {
+    cat.BuildIndexes();
+    cat.is_finalized_ = true;
+  } else {
+    cat.Finalize();
   }
   return cat;
 }
@@ -230,37 +373,126 @@ MapRend Loader::LoadMapRend() const {
 }
 
 Graph Loader::LoadGraph(const TrRoutProto& router_proto) const {
-  auto graph_proto = router_proto.graph();
+  const auto& graph_proto = router_proto.graph();
   Graph graph;
-  for (const auto& edge : graph_proto.edges()) {
-    graph.edges_.push_back(
-        graph::Edge<double>{edge.from(), edge.to(), edge.weight()});
-  }
-  for (const auto& incidence_list : graph_proto.incidence_lists()) {
-    graph.incidence_lists_.push_back({});
-    for (const auto& edge_id : incidence_list.edge_id()) {
-      graph.incidence_lists_.back().push_back(edge_id);
+  graph.offsets_.assign(graph_proto.offsets().begin(),
+                        graph_proto.offsets().end());
+  graph.targets_.assign(graph_proto.targets().begin(),
+                        graph_proto.targets().end());
+  graph.weights_ =
+      LoadWeights(graph_proto.weights(), graph_proto.fixed_weights());
+  if (graph.offsets_.empty() || graph.offsets_.front() != 0 ||
+      graph.offsets_.back() != graph.targets_.size() ||
+      graph.targets_.size() != graph.weights_.size() ||
+      !std::is_sorted(graph.offsets_.begin(), graph.offsets_.end())) {
+    throw std::invalid_argument("Invalid deserialized graph data.");
+  }
+  graph.vertex_count_ = graph.offsets_.size() - 1;
+  for (const auto target : graph.targets_) {
+    if (target >= graph.vertex_count_) {
+      throw std::invalid_argument("Invalid deserialized graph data.");
     }
   }
+  graph.BuildSources();
   return graph;
 }
 
 void Loader::LoadLibRouter(TrRouter& tr_router) const {
-  using RID = graph::Router<double>::RouteInternalData;
-  const auto& router_proto = base_proto_.router();
-  auto& rid = tr_router.router_.routes_internal_data_;
-  for (const auto& rep_rid_pr : router_proto.router().repreprid()) {
-    rid.push_back({});
-    for (const auto& rid_pr : rep_rid_pr.reprid()) {
-      rid.back().push_back(std::nullopt);
-      if (rid_pr.has_weight()) {
-        rid.back().back().emplace(RID{rid_pr.weight(), std::nullopt});
-        if (rid_pr.has_prev_edge()) {
-          rid.back().back()->prev_edge.emplace(rid_pr.prev_edge());
+  const auto& router_pr = base_proto_.router().router();
+  auto& router = tr_router.router_;
+  router.route_weights_ = LoadWeights(router_pr.route_weight(),
+                                     router_pr.route_fixed_weight());
+  router.route_prev_edges_.assign(router_pr.route_prev_edge().begin(),
+                                  router_pr.route_prev_edge().end());
+  const size_t vertex_count = tr_router.graph_.GetVertexCount();
+  if (router.route_weights_.size() != router.route_prev_edges_.size() ||
+      (!router.route_weights_.empty() &&
+       router.route_weights_.size() != vertex_count * vertex_count)) {
+    throw std::invalid_argument("Invalid deserialized router data.");
+  }
+}
+
+// Ranks must number the vertices from zero, and every shortcut must join
+// vertices of the graph through edges and shortcuts before it
+void Loader::LoadContractionHierarchy(TrRouter& tr_router) const {
+  const auto& ch_pr = base_proto_.router().contraction_hierarchy();
+  if (ch_pr.rank().empty()) {
+    return;
+  }
+  auto& ch = tr_router.contraction_hierarchy_;
+  const size_t vertex_count = tr_router.graph_.GetVertexCount();
+  const size_t edge_count = tr_router.graph_.GetEdgeCount();
+  if (static_cast<size_t>(ch_pr.rank_size()) != vertex_count) {
+    throw std::invalid_argument("Invalid deserialized hierarchy data.");
+  }
+  std::vector<bool> is_rank_taken(vertex_count, false);
+  for (const uint32_t rank : ch_pr.rank()) {
+    if (rank >= vertex_count || is_rank_taken[rank]) {
+      throw std::invalid_argument("Invalid deserialized hierarchy data.");
+    }
+    is_rank_taken[rank] = true;
+  }
+  ch.ranks_.assign(ch_pr.rank().begin(), ch_pr.rank().end());
+  for (const auto& shortcut : ch_pr.shortcuts()) {
+    const size_t shortcut_id = edge_count + ch.shortcuts_.size();
+    if (shortcut.from() >= vertex_count || shortcut.to() >= vertex_count ||
+        shortcut.first_edge() >= shortcut_id ||
+        shortcut.second_edge() >= shortcut_id) {
+      throw std::invalid_argument("Invalid deserialized hierarchy data.");
+    }
+    Weight weight;
+    if constexpr (std::is_integral_v<Weight>) {
+      weight = shortcut.fixed_weight();
+    } else {
+      weight = shortcut.weight();
+    }
+    ch.shortcuts_.push_back({shortcut.from(), shortcut.to(), weight,
+                             shortcut.first_edge(), shortcut.second_edge()});
+  }
+  ch.BuildSearchGraph();
+}
+
+// Labels of a vertex must be sorted by hub and their edges must be in the
+// graph
+void Loader::LoadHubLabels(TrRouter& tr_router) const {
+  const auto& hub_labels_pr = base_proto_.router().hub_labels();
+  if (hub_labels_pr.out_labels().offsets().empty()) {
+    return;
+  }
+  auto& hub_labels = tr_router.hub_labels_;
+  const size_t vertex_count = tr_router.graph_.GetVertexCount();
+  const size_t edge_count = tr_router.graph_.GetEdgeCount();
+  auto load_labels = [vertex_count, edge_count](
+                         const protobuf::Labels& labels_pr, auto& labels) {
+    const auto weights =
+        LoadWeights(labels_pr.weight(), labels_pr.fixed_weight());
+    const auto& offsets = labels_pr.offsets();
+    const size_t label_count = labels_pr.hub_size();
+    if (static_cast<size_t>(offsets.size()) != vertex_count + 1 ||
+        offsets[0] != 0 || offsets[vertex_count] != label_count ||
+        !std::is_sorted(offsets.begin(), offsets.end()) ||
+        weights.size() != label_count ||
+        static_cast<size_t>(labels_pr.edge_size()) != label_count) {
+      throw std::invalid_argument("Invalid deserialized hub label data.");
+    }
+    labels.offsets.assign(offsets.begin(), offsets.end());
+    labels.labels.reserve(label_count);
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+      for (size_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i) {
+        const uint32_t hub = labels_pr.hub(i);
+        const uint32_t edge = labels_pr.edge(i);
+        if (hub >= vertex_count ||
+            (i > offsets[vertex] && hub <= labels_pr.hub(i - 1)) ||
+            (edge >= edge_count &&
+             edge != std::numeric_limits<uint32_t>::max())) {
+          throw std::invalid_argument("Invalid deserialized hub label data.");
         }
+        labels.labels.push_back({weights[i], hub, edge});
       }
     }
-  }
+  };
+  load_labels(hub_labels_pr.out_labels(), hub_labels.out_labels_);
+  load_labels(hub_labels_pr.in_labels(), hub_labels.in_labels_);
 }
 
 void Loader::LoadRoutingSettings(TrRouter& tr_router) const {
@@ -269,6 +501,42 @@ void Loader::LoadRoutingSettings(TrRouter& tr_router) const {
       router_proto.settings().bus_wait_time();
   tr_router.routing_settings_.bus_velocity =
       router_proto.settings().bus_velocity();
+  tr_router.routing_settings_.router_mode =
+      static_cast<transport_router::RouterMode>(
+          router_proto.settings().router_mode());
+  tr_router.routing_settings_.route_cache_size =
+      router_proto.settings().route_cache_size();
+  tr_router.routing_settings_.graph_model =
+      static_cast<transport_router::GraphModel>(
+          router_proto.settings().graph_model());
+  tr_router.routing_settings_.row_cache_size =
+      router_proto.settings().row_cache_size();
+  tr_router.routing_settings_.save_route_rows =
+      router_proto.settings().save_route_rows();
+}
+
+// Rows are saved most recently used first, so they are inserted in reverse
+void Loader::LoadRouteRows(TrRouter& tr_router) const {
+  using RouteRow = TrRouter::RouteRow;
+  const auto& rows_pr = base_proto_.router().route_rows();
+  const size_t vertex_count = tr_router.graph_.GetVertexCount();
+  const size_t edge_count = tr_router.graph_.GetEdgeCount();
+  for (auto it = rows_pr.rbegin(); it != rows_pr.rend(); ++it) {
+    auto weights = LoadWeights(it->weight(), it->fixed_weight());
+    if (it->from() >= vertex_count || weights.size() != vertex_count ||
+        it->prev_edge_size() != static_cast<int>(vertex_count) ||
+        std::any_of(it->prev_edge().begin(), it->prev_edge().end(),
+                    [edge_count](uint32_t edge_id) {
+                      return edge_id >= edge_count &&
+                             edge_id != std::numeric_limits<uint32_t>::max();
+                    })) {
+      throw std::invalid_argument("Invalid deserialized route row data.");
+    }
+    tr_router.row_cache_.Insert(
+        it->from(), std::make_shared<const RouteRow>(RouteRow{
+                        std::move(weights),
+                        {it->prev_edge().begin(), it->prev_edge().end()}}));
+  }
 }
 
 void Loader::LoadVertexMap(const TrCat& tr_cat, TrRouter& tr_router) const {
@@ -280,33 +548,58 @@ void Loader::LoadVertexMap(const TrCat& tr_cat, TrRouter& tr_router) const {
   }
 }
 
-void Loader::LoadEdgeMap(const TrCat& tr_cat, TrRouter& tr_router) const {
-  using rec = protobuf::EdgeMap::RouteElementCase;
-  const auto& edge_map_pr = base_proto_.router().edge_id_to_route_element();
-  auto& edge_map = tr_router.edge_id_to_route_element_;
-  for (const auto& elem : edge_map_pr) {
-    switch (elem.route_element_case()) {
-      case rec::kStopId:
-        edge_map.emplace(elem.key(), Wait{tr_cat.stops_[elem.stop_id()].name});
-        break;
-      case rec::kBus:
-        edge_map.emplace(elem.key(),
-                         Bus{tr_cat.buses_[elem.bus().bus_id()].name,
-                             elem.bus().span_count(), elem.bus().time()});
-        break;
-      case rec::ROUTE_ELEMENT_NOT_SET:
-        throw std::invalid_argument("Invalid deserialized edge map data.");
+void Loader::LoadEdgeTable(const TrCat& tr_cat, TrRouter& tr_router) const {
+  using EdgeKind = TrRouter::EdgeKind;
+  const auto& router_proto = base_proto_.router();
+  for (const auto stop_id : router_proto.stop_id()) {
+    tr_router.stop_names_.push_back(tr_cat.stops_.at(stop_id).name);
+  }
+  for (const auto bus_id : router_proto.bus_id()) {
+    tr_router.bus_names_.push_back(tr_cat.buses_.at(bus_id).name);
+  }
+  const auto& table_pr = router_proto.edge_table();
+  const size_t edge_count = tr_router.graph_.GetEdgeCount();
+  if (table_pr.kind_size() != static_cast<int>(edge_count) ||
+      table_pr.element_id_size() != static_cast<int>(edge_count) ||
+      table_pr.span_count_size() != static_cast<int>(edge_count)) {
+    throw std::invalid_argument("Invalid deserialized edge table data.");
+  }
+  auto& edge_infos = tr_router.edge_infos_;
+  edge_infos.reserve(edge_count);
+  for (size_t i = 0; i < edge_count; ++i) {
+    const auto kind = static_cast<EdgeKind>(table_pr.kind(i));
+    const uint32_t element_id = table_pr.element_id(i);
+    if ((kind == EdgeKind::WAIT &&
+         element_id >= tr_router.stop_names_.size()) ||
+        (kind == EdgeKind::BUS &&
+         element_id >= tr_router.bus_names_.size()) ||
+        kind > EdgeKind::BUS) {
+      throw std::invalid_argument("Invalid deserialized edge table data.");
     }
+    edge_infos.push_back(
+        {element_id, static_cast<uint16_t>(table_pr.span_count(i)), kind});
   }
 }
 
 TrRouter Loader::LoadTrRouter(const TrCat& tr_cat) const {
   const auto& router_proto = base_proto_.router();
-  TrRouter tr_router(LoadGraph(router_proto));
-  LoadVertexMap(tr_cat, tr_router);
-  LoadEdgeMap(tr_cat, tr_router);
+  const bool is_raptor = static_cast<transport_router::RouterMode>(
+                             router_proto.settings().router_mode()) ==
+                         transport_router::RouterMode::RAPTOR;
+  TrRouter tr_router(is_raptor ? Graph{} : LoadGraph(router_proto));
+  if (is_raptor) {
+    LoadEdgeTable(tr_cat, tr_router);
+    tr_router.graph_ = tr_router.BuildStopGraph();
+  } else {
+    LoadVertexMap(tr_cat, tr_router);
+    LoadEdgeTable(tr_cat, tr_router);
+  }
   LoadLibRouter(tr_router);
+  LoadContractionHierarchy(tr_router);
+  LoadHubLabels(tr_router);
   LoadRoutingSettings(tr_router);
+  tr_router.InitializeSearch(tr_cat);
+  LoadRouteRows(tr_router);
   return tr_router;
 }
 
@@ -341,12 +634,12 @@ svg::Color Loader::LoadColor(const protobuf::Color& color_proto) const {
 
 // -- functions --
 
-bool MakeBase(std::istream& input) {
+bool MakeBase(std::istream& input, size_t thread_count) {
   TrCat cat;
   JSONrr reader(json::Load(input));
   reader.ProcessBaseRequests(cat);
   MapRend renderer(std::move(reader.GetRenderSettings()));
-  TrRouter router{reader.GetRoutingSettings(), cat};
+  TrRouter router{reader.GetRoutingSettings(), cat, thread_count};
   Saver saver(std::move(reader.GetSerSettings()), cat, router);
   saver.SaveTrCat();
   saver.SaveTrRouter();
@@ -354,7 +647,30 @@ bool MakeBase(std::istream& input) {
   return saver.Write();
 }
 
-bool ProcessRequests(std::istream& input, std::ostream& output) {
+// The base requests are applied to the catalogue of the base, and the
+// router is updated rather than built anew
+bool UpdateBase(std::istream& input, size_t thread_count) {
+  JSONrr reader(json::Load(input));
+  Loader loader(reader.GetSerSettings());
+  if (!loader.Read()) {
+    return false;
+  }
+  // The catalogue is changed in place, its interned names outlive the
+  // changes, so the router's views of them stay valid until Update
+  TrCat cat = loader.LoadTrCat();
+  TrRouter router = loader.LoadTrRouter(cat);
+  reader.ProcessBaseRequests(cat);
+  router.Update(cat, thread_count);
+  const MapRend renderer = loader.LoadMapRend();
+  Saver saver(reader.GetSerSettings(), cat, router);
+  saver.SaveTrCat();
+  saver.SaveTrRouter();
+  saver.SaveMapRend(renderer);
+  return saver.Write();
+}
+
+bool ProcessRequests(std::istream& input, std::ostream& output,
+                     size_t thread_count, std::ostream* cache_stats) {
   JSONrr reader(json::Load(input));
   Loader loader(std::move(reader.GetSerSettings()));
   if (!loader.Read()) {
@@ -364,8 +680,21 @@ bool ProcessRequests(std::istream& input, std::ostream& output) {
   auto router = loader.LoadTrRouter(cat);
   auto renderer = loader.LoadMapRend();
   ReqHand req_hand;
-  req_hand.ProcessStatRequests(cat, router, renderer, reader.GetStatRequests());
+  req_hand.ProcessStatRequests(cat, router, renderer, reader.GetStatRequests(),
+                               thread_count);
   req_hand.PrintRequests(output);
+  if (cache_stats) {
+    PrintCacheStats("Route", router.GetRouteCacheStats(), *cache_stats);
+    PrintCacheStats("Row", router.GetRowCacheStats(), *cache_stats);
+  }
+  // Rows searched by these requests serve the next run from the start
+  if (router.GetRoutingSettings().save_route_rows) {
+    Saver saver(reader.GetSerSettings(), cat, router);
+    saver.SaveTrCat();
+    saver.SaveTrRouter();
+    saver.SaveMapRend(renderer);
+    return saver.Write();
+  }
   return true;
 }
 
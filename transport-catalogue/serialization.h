@@ -4,6 +4,7 @@
 
 #include <iostream>
 
+#include "route_weight.h"
 #include "svg.h"
 
 namespace catalogue {
@@ -27,7 +28,7 @@ namespace serialization {
 
 using TrCat = catalogue::TransportCatalogue;
 using MapRend = map_renderer::MapRenderer;
-using Graph = graph::DirectedWeightedGraph<double>;
+using Graph = graph::DirectedWeightedGraph<transport_router::Weight>;
 using TrRouter = transport_router::TransportRouter;
 using TrCatProto = protobuf::TransportCatalogue;
 using TrRoutProto = protobuf::TransportRouter;
@@ -46,9 +47,12 @@ class Saver {
 
  private:
   void SaveVertexMap(TrRoutProto* router_proto);
-  void SaveEdgeMap(TrRoutProto* router_proto);
+  void SaveEdgeTable(TrRoutProto* router_proto);
   void SaveGraph(TrRoutProto* router_proto);
   void SaveRouter(TrRoutProto* router_proto);
+  void SaveContractionHierarchy(TrRoutProto* router_proto);
+  void SaveHubLabels(TrRoutProto* router_proto);
+  void SaveRouteRows(TrRoutProto* router_proto);
   void SaveColor(protobuf::Color* color_proto, const svg::Color& color) const;
 
   const TrCat& cat_;
@@ -68,16 +72,25 @@ class Loader {
  private:
   Graph LoadGraph(const TrRoutProto& router_proto) const;
   void LoadLibRouter(TrRouter& tr_router) const;
+  void LoadContractionHierarchy(TrRouter& tr_router) const;
+  void LoadHubLabels(TrRouter& tr_router) const;
   void LoadRoutingSettings(TrRouter& tr_router) const;
+  void LoadRouteRows(TrRouter& tr_router) const;
   void LoadVertexMap(const TrCat& tr_cat, TrRouter& tr_router) const;
-  void LoadEdgeMap(const TrCat& tr_cat, TrRouter& tr_router) const;
+  void LoadEdgeTable(const TrCat& tr_cat, TrRouter& tr_router) const;
   svg::Color LoadColor(const protobuf::Color& color_proto) const;
 
   TrCatProto base_proto_;
   SerSettings settings_;
 };
 
-bool MakeBase(std::istream& input);
-bool ProcessRequests(std::istream& input, std::ostream& output);
+bool MakeBase(std::istream& input, size_t thread_count = 1);
+bool UpdateBase(std::istream& input, size_t thread_count = 1);
+// Modifies the base if its routing settings set save_route_rows: the rows
+// searched by the requests are written back to it. Hits and misses of the
+// route and row caches go to cache_stats if it is given.
+bool ProcessRequests(std::istream& input, std::ostream& output,
+                     size_t thread_count = 1,
+                     std::ostream* cache_stats = nullptr);
 
 }  // namespace serialization
\ No newline at end of file
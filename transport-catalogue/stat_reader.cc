@@ -25,7 +25,7 @@ void StatReader::PrintStopInfo(const catalogue::StopInfo& s) {
   output_ << "Stop "s << s.name << ": "s;
   if (!s.is_found) {
     output_ << "not found"s;
-  } else if (s.buses.size() == 0) {
+  } else if (s.buses.begin() == s.buses.end()) {
     output_ << "no buses"s;
   } else {
     output_ << "buses";
@@ -0,0 +1,74 @@
+#include "string_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace string_pool {
+
+void StringPool::Reserve(size_t count, size_t size) {
+  ReserveSlots(string_count_ + count);
+  if (size == 0 || (!blocks_.empty() && capacity_ - used_ >= size)) {
+    return;
+  }
+  blocks_.push_back(std::make_unique<char[]>(size));
+  used_ = 0;
+  capacity_ = size;
+}
+
+// The rest of the last block is given up to a string that does not fit
+char* StringPool::Allocate(size_t size) {
+  if (blocks_.empty() || capacity_ - used_ < size) {
+    const size_t block_size = std::max(size, BLOCK_SIZE);
+    blocks_.push_back(std::make_unique<char[]>(block_size));
+    used_ = 0;
+    capacity_ = block_size;
+  }
+  char* data = blocks_.back().get() + used_;
+  used_ += size;
+  return data;
+}
+
+void StringPool::ReserveSlots(size_t count) {
+  size_t slot_count = std::max(slots_.size(), MIN_SLOT_COUNT);
+  while (slot_count < 2 * count) {
+    slot_count *= 2;
+  }
+  if (slot_count == slots_.size()) {
+    return;
+  }
+  std::vector<std::string_view> old_slots(slot_count);
+  old_slots.swap(slots_);
+  for (const std::string_view str : old_slots) {
+    if (str.data() != nullptr) {
+      slots_[FindSlot(str)] = str;
+    }
+  }
+}
+
+size_t StringPool::FindSlot(std::string_view str) const {
+  const size_t mask = slots_.size() - 1;
+  size_t slot = std::hash<std::string_view>{}(str) & mask;
+  while (slots_[slot].data() != nullptr && slots_[slot] != str) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+std::string_view StringPool::Intern(std::string_view str) {
+  if (str.empty()) {
+    return {};
+  }
+  ReserveSlots(string_count_ + 1);
+  const size_t slot = FindSlot(str);
+  if (slots_[slot].data() != nullptr) {
+    return slots_[slot];
+  }
+  char* data = Allocate(str.size());
+  std::memcpy(data, str.data(), str.size());
+  slots_[slot] = {data, str.size()};
+  ++string_count_;
+  return slots_[slot];
+}
+
+}  // namespace string_pool
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace string_pool {
+
+// Keeps one copy of every distinct string in blocks that are never moved or
+// freed before the pool, so the views it hands out stay valid while it lives
+// and moving the pool keeps them valid too. Strings are not released one by
+// one.
+class StringPool {
+ public:
+  StringPool() = default;
+  StringPool(const StringPool&) = delete;
+  StringPool& operator=(const StringPool&) = delete;
+  StringPool(StringPool&&) = default;
+  StringPool& operator=(StringPool&&) = default;
+
+  // Makes room for count more strings of size bytes in total, so that
+  // interning them takes no more allocations and lays them side by side
+  void Reserve(size_t count, size_t size);
+  // The pool's copy of str, made on the first call
+  std::string_view Intern(std::string_view str);
+
+ private:
+  static constexpr size_t BLOCK_SIZE = 4096;
+  static constexpr size_t MIN_SLOT_COUNT = 16;
+
+  char* Allocate(size_t size);
+  // Rehashes so that count strings fill at most half of the slots
+  void ReserveSlots(size_t count);
+  size_t FindSlot(std::string_view str) const;
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  // Bytes taken and total bytes of the last block
+  size_t used_ = 0;
+  size_t capacity_ = 0;
+  // Open addressing with linear probing over a power-of-two table, free
+  // slots have no data
+  std::vector<std::string_view> slots_;
+  size_t string_count_ = 0;
+};
+
+}  // namespace string_pool
@@ -1,72 +1,675 @@
-// namespace test {
-
-// json::Document LoadJSON(const std::string& s) {
-//   std::istringstream strm(s);
-//   return json::Load(strm);
-// }
-
-// void TestTC() {
-//   using namespace std::literals;
-//   using namespace catalogue;
-//   TransportCatalogue cat;
-//   cat.AddStop("Tolstopaltsevo"s, {55.611087, 37.208290});
-//   cat.AddStop("Marushkino"s, {55.595884, 37.209755});
-//   cat.AddStop("Rasskazovka"s, {55.632761, 37.333324});
-//   cat.AddStop("Universam"s, {55.587655, 37.645687});
-//   cat.AddStop("Universam2"s, {77.77, 99.99});
-//   cat.AddStop("Rasskazovka"s, {777.888, 888.777});
-
-//   cat.AddRoute("256"s, {"Biryulyovo Zapadnoye"s, "Biryusinka", "Universam"s},
-//   false);
-
-//   cat.AddStop("Biryulyovo Zapadnoye"s, {55.574371, 37.651700});
-//   cat.AddStop("Biryusinka"s, {55.581065, 37.648390});
-//   cat.AddStop("Biryulyovo Tovarnaya"s, {55.592028, 37.653656});
-//   cat.AddStop("Biryulyovo Passazhirskaya"s, {55.580999, 37.659164});
-//   cat.AddRoute("255"s, {"Biryulyovo Zapadnoye"s, "Biryusinka", "Universam"s,
-//                         "Biryulyovo Tovarnaya"s, "Biryulyovo Zapadnoye"s},
-//                         true);
-//   cat.AddRoute("254"s, {"Biryulyovo Zapadnoye"s, "Biryusinka", "Universam2"s,
-//                         "Biryulyovo Tovarnaya"s, "Biryulyovo Zapadnoye"s},
-//                         true);
-//   [[maybe_unused]] const RouteInfo r_256 = cat.GetRouteInfo("256"s);
-//   [[maybe_unused]] const StopInfo s_i = cat.GetStopInfo("Universam"s);
-//   return;
-// }
-
-// void TestIR() {
-//   catalogue::TransportCatalogue cat;
-//   io::InputReader reader(std::cin, std::cout);
-//   reader.ReadInput();
-//   reader.ProcessQueries(cat);
-//   return;
-// }
-
-// void TestJR() {
-//   using namespace std;
-//   using namespace jreader;
-//   using namespace catalogue;
-//   using namespace reqhandler;
-//   TransportCatalogue c;
-//   JSONreader jr(json::Load(cin));
-//   jr.ProcessBaseRequests(c);
-//   RequestHandler rh;
-//   rh.ProcessStatRequests(c, jr.GetStatRequests());
-//   rh.PrintRequests(cout);
-//   return;
-// }
-
-// void TestMapRenderer() {
-//   using namespace json_reader;
-//   using namespace map_renderer;
-//   using namespace request_handler;
-//   using namespace catalogue;
-
-//   JSONreader jr(json::Load(std::cin));
-//   TransportCatalogue cat;
-//   jr.ProcessBaseRequests(cat);
-//   MapRenderer mr{jr.GetRenderSettings()};
-//   mr.RenderMap(cat, std::cout);
-// }
-
-// }  // namespace test
\ No newline at end of file
+#include "tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "contraction_hierarchy.h"
+#include "graph.h"
+#include "hub_labels.h"
+#include "json.h"
+#include "min_plus.h"
+#include "router.h"
+
+namespace test {
+
+namespace {
+
+using namespace std::literals;
+
+void Check(bool condition, const std::string& message) {
+  if (!condition) {
+    throw std::runtime_error(message);
+  }
+}
+
+template <typename Weight>
+constexpr Weight INFINITE_WEIGHT =
+    std::numeric_limits<Weight>::has_infinity
+        ? std::numeric_limits<Weight>::infinity()
+        : std::numeric_limits<Weight>::max();
+
+// Small whole numbers make equal weights and equally light routes common
+template <typename Weight>
+Weight MakeRandomWeight(std::mt19937& engine, int max_units) {
+  const int units = std::uniform_int_distribution<int>(0, max_units)(engine);
+  if constexpr (std::is_integral_v<Weight>) {
+    return units;
+  } else {
+    return engine() % 2 == 0
+               ? units
+               : units + std::uniform_real_distribution<Weight>(0., 1.)(engine);
+  }
+}
+
+template <typename Weight>
+void TestRelaxRowKernels(const std::string& weight_name) {
+  using min_plus::NO_PREV_EDGE;
+  using min_plus::PrevEdgeId;
+  constexpr size_t MAX_COUNT = 37;
+  constexpr int ROUNDS = 20;
+  std::mt19937 engine(19);
+  const auto kernels = min_plus::GetKernels<Weight>();
+  // Every count up to past two vectors of every width, from an aligned and
+  // an unaligned start, with missing routes in both rows
+  for (size_t count = 0; count <= MAX_COUNT; ++count) {
+    for (size_t offset = 0; offset < 2; ++offset) {
+      for (int round = 0; round < ROUNDS; ++round) {
+        std::vector<Weight> weights(offset + count);
+        std::vector<Weight> weights_through(offset + count);
+        std::vector<PrevEdgeId> prev_edges(offset + count);
+        std::vector<PrevEdgeId> prev_edges_through(offset + count);
+        for (size_t i = 0; i < offset + count; ++i) {
+          weights[i] = engine() % 4 == 0 ? INFINITE_WEIGHT<Weight>
+                                         : MakeRandomWeight<Weight>(engine, 40);
+          weights_through[i] = engine() % 4 == 0
+                                   ? INFINITE_WEIGHT<Weight>
+                                   : MakeRandomWeight<Weight>(engine, 20);
+          prev_edges[i] = engine() % 4 == 0 ? NO_PREV_EDGE : engine() % 1000;
+          prev_edges_through[i] =
+              engine() % 4 == 0 ? NO_PREV_EDGE : engine() % 1000;
+        }
+        const Weight weight_from = MakeRandomWeight<Weight>(engine, 20);
+        const PrevEdgeId prev_edge_from = engine() % 1000;
+
+        auto expected_weights = weights;
+        auto expected_prev_edges = prev_edges;
+        min_plus::RelaxRowScalar(
+            expected_weights.data() + offset,
+            expected_prev_edges.data() + offset,
+            weights_through.data() + offset, prev_edges_through.data() + offset,
+            count, weight_from, prev_edge_from);
+        for (const auto& [name, kernel] : kernels) {
+          auto kernel_weights = weights;
+          auto kernel_prev_edges = prev_edges;
+          kernel(kernel_weights.data() + offset,
+                 kernel_prev_edges.data() + offset,
+                 weights_through.data() + offset,
+                 prev_edges_through.data() + offset, count, weight_from,
+                 prev_edge_from);
+          Check(kernel_weights == expected_weights &&
+                    kernel_prev_edges == expected_prev_edges,
+                "RelaxRow kernel "s + name + " of " + weight_name +
+                    " weights differs from the scalar one, count " +
+                    std::to_string(count) + ", offset " +
+                    std::to_string(offset));
+        }
+      }
+    }
+  }
+}
+
+template <typename Weight>
+using Graph = graph::DirectedWeightedGraph<Weight>;
+template <typename Weight>
+using RouteInfo = typename graph::Router<Weight>::RouteInfo;
+
+// Up to 24 vertices, with parallel edges, loops, free edges and vertices
+// that no route reaches
+template <typename Weight>
+Graph<Weight> MakeRandomGraph(std::mt19937& engine) {
+  const size_t vertex_count = 1 + engine() % 24;
+  const size_t edge_count = engine() % (3 * vertex_count + 1);
+  Graph<Weight> graph(vertex_count);
+  for (size_t i = 0; i < edge_count; ++i) {
+    graph.AddEdge({engine() % vertex_count, engine() % vertex_count,
+                   MakeRandomWeight<Weight>(engine, 9)});
+  }
+  graph.Freeze();
+  return graph;
+}
+
+// Sums of doubles depend on their order
+template <typename Weight>
+bool IsNear(Weight lhs, Weight rhs) {
+  if constexpr (std::is_integral_v<Weight>) {
+    return lhs == rhs;
+  } else {
+    return std::abs(lhs - rhs) <= 1e-9 * std::max(1., std::abs(rhs));
+  }
+}
+
+// The route must lead from from to to along its edges, weigh their sum and
+// be as light as the one of Dijkstra's algorithm
+template <typename Weight>
+void CheckRoute(const Graph<Weight>& graph, graph::VertexId from,
+                graph::VertexId to,
+                const std::optional<RouteInfo<Weight>>& route,
+                const std::optional<RouteInfo<Weight>>& expected,
+                const std::string& what) {
+  const std::string where = what + ", route " + std::to_string(from) +
+                            " -> " + std::to_string(to) + " of " +
+                            std::to_string(graph.GetVertexCount()) +
+                            " vertices";
+  Check(route.has_value() == expected.has_value(),
+        where + ": found " + (route ? "a route" : "none") +
+            ", Dijkstra's algorithm " + (expected ? "a route" : "none"));
+  if (!route) {
+    return;
+  }
+  graph::VertexId vertex = from;
+  Weight weight{};
+  for (const graph::EdgeId edge_id : route->edges) {
+    const auto edge = graph.GetEdge(edge_id);
+    Check(edge.from == vertex, where + ": edges do not chain");
+    vertex = edge.to;
+    weight += edge.weight;
+  }
+  Check(vertex == to, where + ": edges end elsewhere");
+  Check(IsNear(weight, route->weight),
+        where + ": weight is not the sum of the edges");
+  Check(IsNear(route->weight, expected->weight),
+        where + ": weight differs from Dijkstra's algorithm");
+}
+
+constexpr int GRAPH_COUNT = 300;
+
+template <typename Weight>
+void TestContractionHierarchy(const std::string& weight_name) {
+  std::mt19937 engine(4);
+  for (int i = 0; i < GRAPH_COUNT; ++i) {
+    const auto graph = MakeRandomGraph<Weight>(engine);
+    const graph::Router<Weight> router(graph, false);
+    const graph::ContractionHierarchy<Weight> contraction_hierarchy(graph);
+    for (graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+      for (graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+        CheckRoute(graph, from, to, contraction_hierarchy.BuildRoute(from, to),
+                   router.BuildRouteOnDemand(from, to),
+                   "Contraction hierarchy of " + weight_name + " weights");
+      }
+    }
+  }
+}
+
+template <typename Weight>
+void TestHubLabels(const std::string& weight_name) {
+  std::mt19937 engine(18);
+  for (int i = 0; i < GRAPH_COUNT; ++i) {
+    const auto graph = MakeRandomGraph<Weight>(engine);
+    const graph::Router<Weight> router(graph, false);
+    const graph::HubLabels<Weight> hub_labels(graph);
+    for (graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+      for (graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+        const std::string what = "Hub labels of " + weight_name + " weights";
+        const auto route = hub_labels.BuildRoute(from, to);
+        CheckRoute(graph, from, to, route, router.BuildRouteOnDemand(from, to),
+                   what);
+        const auto weight = hub_labels.BuildRouteWeight(from, to);
+        Check(weight.has_value() == route.has_value() &&
+                  (!weight || *weight == route->weight),
+              what + ", route " + std::to_string(from) + " -> " +
+                  std::to_string(to) + ": label merge differs from the route");
+      }
+    }
+  }
+}
+
+const std::vector<std::string> ROUTER_MODES{
+    "precomputed"s, "on_demand"s, "contraction_hierarchy"s, "a_star"s,
+    "bidirectional"s, "raptor"s, "lazy_rows"s, "hub_labels"s};
+const std::vector<std::string> GRAPH_MODELS{"complete"s, "route_pattern"s};
+
+json::Node LoadJson(const std::string& file) {
+  std::ifstream in(file);
+  Check(static_cast<bool>(in), "Cannot read "s + file);
+  return json::Load(in).GetRoot();
+}
+
+void SaveJson(const json::Node& root, const std::string& file) {
+  std::ofstream out(file);
+  json::Print(json::Document{root}, out);
+  Check(static_cast<bool>(out), "Cannot write "s + file);
+}
+
+std::string ReadFile(const std::string& file) {
+  std::ifstream in(file, std::ios::binary);
+  Check(static_cast<bool>(in), "Cannot read "s + file);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// Standard output goes to output_file if one is given
+void Run(const std::string& program, const std::string& arguments,
+         const std::string& input_file, const std::string& output_file = {}) {
+  std::string command =
+      "\""s + program + "\" "s + arguments + " < \""s + input_file + "\""s;
+  if (!output_file.empty()) {
+    command += " > \""s + output_file + "\""s;
+  }
+  Check(std::system(command.c_str()) == 0, "Failed: "s + command);
+}
+
+struct Inputs {
+  std::string make_base_file;
+  std::string requests_file;
+};
+
+// Writes both inputs of the dataset for a base named name, with the given
+// routing settings put over the dataset's ones
+Inputs WriteInputs(const json::Node& make_base, const json::Node& requests,
+                   const std::string& name,
+                   const json::Dict& routing_settings) {
+  const json::Dict serialization_settings{{"file"s, name + ".db"s}};
+  json::Node make_base_copy = make_base;
+  auto& make_base_dict = make_base_copy.AsModDict();
+  make_base_dict["serialization_settings"s] = serialization_settings;
+  auto& settings = make_base_dict.at("routing_settings"s).AsModDict();
+  for (const auto& [key, value] : routing_settings) {
+    settings[key] = value;
+  }
+  json::Node requests_copy = requests;
+  requests_copy.AsModDict()["serialization_settings"s] =
+      serialization_settings;
+
+  Inputs inputs{name + "_make_base.json"s, name + "_requests.json"s};
+  SaveJson(make_base_copy, inputs.make_base_file);
+  SaveJson(requests_copy, inputs.requests_file);
+  return inputs;
+}
+
+constexpr double TOLERANCE_PER_EDGE = 0.001;
+
+// Answers are printed with six significant digits
+double GetPrintTolerance(double lhs, double rhs) {
+  return 1e-5 * std::max(std::abs(lhs), std::abs(rhs));
+}
+
+void CheckNear(double lhs, double rhs, size_t edge_count,
+               const std::string& what) {
+  Check(std::abs(lhs - rhs) <=
+            TOLERANCE_PER_EDGE * edge_count + GetPrintTolerance(lhs, rhs),
+        what + ": "s + std::to_string(lhs) + " and "s + std::to_string(rhs) +
+            " over "s + std::to_string(edge_count) + " edges"s);
+}
+
+bool IsError(const json::Node& answer) {
+  return answer.AsDict().count("error_message"s) != 0;
+}
+
+// Every item is one edge, except that a ride of the route pattern model takes
+// an edge per stop
+size_t CountEdges(const json::Node& item, bool is_route_pattern) {
+  const auto& dict = item.AsDict();
+  if (is_route_pattern && dict.at("type"s).AsString() == "Bus"s) {
+    return dict.at("span_count"s).AsInt();
+  }
+  return 1;
+}
+
+size_t CountEdges(const json::Array& items, bool is_route_pattern) {
+  size_t edge_count = 0;
+  for (const auto& item : items) {
+    edge_count += CountEdges(item, is_route_pattern);
+  }
+  return edge_count;
+}
+
+bool HaveSameItems(const json::Array& lhs, const json::Array& rhs) {
+  auto strip_time = [](const json::Node& item) {
+    json::Dict dict = item.AsDict();
+    dict.erase("time"s);
+    return dict;
+  };
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                    [&](const json::Node& lhs_item,
+                        const json::Node& rhs_item) {
+                      return strip_time(lhs_item) == strip_time(rhs_item);
+                    });
+}
+
+using StopPair = std::pair<std::string, std::string>;
+
+// The Route, RouteMatrix and Isochrone requests of the dataset, and Route
+// requests for every cell of the matrices and from the origin of every
+// isochrone to every stop. Their routes tell how many edges a time adds up.
+struct ToleranceRequests {
+  json::Node requests;
+  std::map<StopPair, size_t> route_indices;
+};
+
+ToleranceRequests MakeToleranceRequests(const json::Node& make_base,
+                                        const json::Node& requests) {
+  std::vector<std::string> stop_names;
+  for (const auto& request :
+       make_base.AsDict().at("base_requests"s).AsArray()) {
+    if (request.AsDict().at("type"s).AsString() == "Stop"s) {
+      stop_names.push_back(request.AsDict().at("name"s).AsString());
+    }
+  }
+  json::Array stat_requests;
+  int max_id = 0;
+  for (const auto& request :
+       requests.AsDict().at("stat_requests"s).AsArray()) {
+    const auto& type = request.AsDict().at("type"s).AsString();
+    max_id = std::max(max_id, request.AsDict().at("id"s).AsInt());
+    if (type == "Route"s || type == "RouteMatrix"s || type == "Isochrone"s) {
+      stat_requests.push_back(request);
+    }
+  }
+
+  ToleranceRequests result;
+  auto add_route = [&](const std::string& from, const std::string& to) {
+    if (result.route_indices.count({from, to}) == 0) {
+      result.route_indices[{from, to}] = stat_requests.size();
+      stat_requests.push_back(json::Dict{{"id"s, ++max_id},
+                                         {"type"s, "Route"s},
+                                         {"from"s, from},
+                                         {"to"s, to}});
+    }
+  };
+  for (size_t i = 0, size = stat_requests.size(); i < size; ++i) {
+    const auto& request = stat_requests[i].AsDict();
+    const auto& type = request.at("type"s).AsString();
+    if (type == "Route"s) {
+      result.route_indices.emplace(StopPair{request.at("from"s).AsString(),
+                                            request.at("to"s).AsString()},
+                                   i);
+    }
+  }
+  for (size_t i = 0, size = stat_requests.size(); i < size; ++i) {
+    // Copied, as adding routes moves the requests
+    const json::Dict request = stat_requests[i].AsDict();
+    const auto& type = request.at("type"s).AsString();
+    if (type == "RouteMatrix"s) {
+      for (const auto& from : request.at("from"s).AsArray()) {
+        for (const auto& to : request.at("to"s).AsArray()) {
+          add_route(from.AsString(), to.AsString());
+        }
+      }
+    } else if (type == "Isochrone"s) {
+      for (const auto& to : stop_names) {
+        add_route(request.at("from"s).AsString(), to);
+      }
+    }
+  }
+  result.requests = json::Dict{
+      {"serialization_settings"s, requests.AsDict().at(
+                                      "serialization_settings"s)},
+      {"stat_requests"s, std::move(stat_requests)}};
+  return result;
+}
+
+class ToleranceChecker {
+ public:
+  ToleranceChecker(const ToleranceRequests& requests, const json::Array& lhs,
+                   const json::Array& rhs, bool is_route_pattern,
+                   std::string what)
+      : requests_(requests),
+        lhs_(lhs),
+        rhs_(rhs),
+        is_route_pattern_(is_route_pattern),
+        what_(std::move(what)) {}
+
+  void CheckAnswers() const {
+    const auto& stat_requests =
+        requests_.requests.AsDict().at("stat_requests"s).AsArray();
+    Check(lhs_.size() == stat_requests.size() &&
+              rhs_.size() == stat_requests.size(),
+          what_ + ": answer count differs");
+    for (size_t i = 0; i < stat_requests.size(); ++i) {
+      const auto& request = stat_requests[i].AsDict();
+      const std::string where =
+          what_ + ", request "s + std::to_string(request.at("id"s).AsInt());
+      Check(IsError(lhs_[i]) == IsError(rhs_[i]),
+            where + ": only one answer is an error"s);
+      if (IsError(lhs_[i])) {
+        continue;
+      }
+      const auto& type = request.at("type"s).AsString();
+      if (type == "Route"s) {
+        CheckRoute(lhs_[i].AsDict(), rhs_[i].AsDict(), where);
+      } else if (type == "RouteMatrix"s) {
+        CheckRouteMatrix(request, lhs_[i].AsDict(), rhs_[i].AsDict(), where);
+      } else {
+        CheckIsochrone(request, lhs_[i].AsDict(), rhs_[i].AsDict(), where);
+      }
+    }
+  }
+
+ private:
+  // Routes may differ where their weights are within rounding of each other,
+  // their times may not
+  void CheckRoute(const json::Dict& lhs, const json::Dict& rhs,
+                  const std::string& where) const {
+    const auto& lhs_items = lhs.at("items"s).AsArray();
+    const auto& rhs_items = rhs.at("items"s).AsArray();
+    if (HaveSameItems(lhs_items, rhs_items)) {
+      for (size_t i = 0; i < lhs_items.size(); ++i) {
+        CheckNear(lhs_items[i].AsDict().at("time"s).AsDouble(),
+                  rhs_items[i].AsDict().at("time"s).AsDouble(),
+                  CountEdges(lhs_items[i], is_route_pattern_),
+                  where + ", item "s + std::to_string(i));
+      }
+    }
+    CheckNear(lhs.at("total_time"s).AsDouble(),
+              rhs.at("total_time"s).AsDouble(),
+              std::max(CountEdges(lhs_items, is_route_pattern_),
+                       CountEdges(rhs_items, is_route_pattern_)),
+              where + ", total time"s);
+  }
+
+  size_t CountRouteEdges(const json::Array& answers,
+                         const StopPair& stops) const {
+    const auto& answer = answers.at(requests_.route_indices.at(stops));
+    if (IsError(answer)) {
+      return 0;
+    }
+    return CountEdges(answer.AsDict().at("items"s).AsArray(),
+                      is_route_pattern_);
+  }
+
+  size_t CountRouteEdges(const StopPair& stops) const {
+    return std::max(CountRouteEdges(lhs_, stops), CountRouteEdges(rhs_, stops));
+  }
+
+  void CheckRouteMatrix(const json::Dict& request, const json::Dict& lhs,
+                        const json::Dict& rhs, const std::string& where) const {
+    const auto& from = request.at("from"s).AsArray();
+    const auto& to = request.at("to"s).AsArray();
+    const auto& lhs_rows = lhs.at("total_time"s).AsArray();
+    const auto& rhs_rows = rhs.at("total_time"s).AsArray();
+    for (size_t i = 0; i < from.size(); ++i) {
+      for (size_t j = 0; j < to.size(); ++j) {
+        const auto& lhs_cell = lhs_rows.at(i).AsArray().at(j);
+        const auto& rhs_cell = rhs_rows.at(i).AsArray().at(j);
+        const std::string cell = where + ", cell "s + from[i].AsString() +
+                                 " -> "s + to[j].AsString();
+        Check(lhs_cell.IsNull() == rhs_cell.IsNull(),
+              cell + ": only one has a route"s);
+        if (!lhs_cell.IsNull()) {
+          CheckNear(lhs_cell.AsDouble(), rhs_cell.AsDouble(),
+                    CountRouteEdges({from[i].AsString(), to[j].AsString()}),
+                    cell);
+        }
+      }
+    }
+  }
+
+  // A stop reached by one program only must be within rounding of max_time
+  void CheckIsochrone(const json::Dict& request, const json::Dict& lhs,
+                      const json::Dict& rhs, const std::string& where) const {
+    const auto& from = request.at("from"s).AsString();
+    const double max_time = request.at("max_time"s).AsDouble();
+    auto get_times = [](const json::Dict& answer) {
+      std::map<std::string, double> times;
+      for (const auto& stop : answer.at("stops"s).AsArray()) {
+        times[stop.AsDict().at("stop_name"s).AsString()] =
+            stop.AsDict().at("time"s).AsDouble();
+      }
+      return times;
+    };
+    const auto lhs_times = get_times(lhs);
+    const auto rhs_times = get_times(rhs);
+    auto check_stops = [&](const std::map<std::string, double>& times,
+                           const std::map<std::string, double>& other_times) {
+      for (const auto& [stop_name, time] : times) {
+        const size_t edge_count = CountRouteEdges({from, stop_name});
+        const std::string stop = where + ", stop "s + stop_name;
+        const auto it = other_times.find(stop_name);
+        if (it != other_times.end()) {
+          CheckNear(time, it->second, edge_count, stop);
+        } else {
+          CheckNear(time, std::max(time, max_time), edge_count,
+                    stop + " reached by one program only"s);
+        }
+      }
+    };
+    check_stops(lhs_times, rhs_times);
+    check_stops(rhs_times, lhs_times);
+  }
+
+  const ToleranceRequests& requests_;
+  const json::Array& lhs_;
+  const json::Array& rhs_;
+  bool is_route_pattern_;
+  std::string what_;
+};
+
+}  // namespace
+
+void TestRelaxRowKernels() {
+  TestRelaxRowKernels<double>("double"s);
+  TestRelaxRowKernels<int32_t>("int32_t"s);
+}
+
+void TestContractionHierarchy() {
+  TestContractionHierarchy<double>("double"s);
+  TestContractionHierarchy<int32_t>("int32_t"s);
+}
+
+void TestHubLabels() {
+  TestHubLabels<double>("double"s);
+  TestHubLabels<int32_t>("int32_t"s);
+}
+
+// Small caches evict while the threads share them. The lazy rows mode also
+// saves its rows and answers again from the saved ones.
+void TestThreadCounts(const std::string& program,
+                      const std::string& make_base_file,
+                      const std::string& requests_file) {
+  const json::Node make_base = LoadJson(make_base_file);
+  const json::Node requests = LoadJson(requests_file);
+  for (const auto& router_mode : ROUTER_MODES) {
+    for (const auto& graph_model : GRAPH_MODELS) {
+      const bool save_route_rows = router_mode == "lazy_rows"s;
+      const json::Dict routing_settings{{"router_mode"s, router_mode},
+                                        {"graph_model"s, graph_model},
+                                        {"route_cache_size"s, 16},
+                                        {"row_cache_size"s, 8},
+                                        {"save_route_rows"s, save_route_rows}};
+      std::vector<std::string> answers;
+      for (const int thread_count : {1, 4}) {
+        const std::string name = "threads_"s + router_mode + "_"s +
+                                 graph_model + "_"s +
+                                 std::to_string(thread_count);
+        const Inputs inputs =
+            WriteInputs(make_base, requests, name, routing_settings);
+        const std::string threads =
+            "--threads="s + std::to_string(thread_count);
+        Run(program, "make_base "s + threads, inputs.make_base_file);
+        for (int run = 0; run < (save_route_rows ? 2 : 1); ++run) {
+          const std::string answers_file =
+              name + "_answers_"s + std::to_string(run) + ".json"s;
+          Run(program, "process_requests "s + threads, inputs.requests_file,
+              answers_file);
+          answers.push_back(ReadFile(answers_file));
+        }
+      }
+      for (const auto& answer : answers) {
+        Check(answer == answers.front(),
+              "Answers differ between thread counts in the "s + router_mode +
+                  " mode of the "s + graph_model + " graph model"s);
+      }
+    }
+  }
+}
+
+void TestWeightTolerance(const std::string& program,
+                         const std::string& other_program,
+                         const std::string& make_base_file,
+                         const std::string& requests_file) {
+  const json::Node make_base = LoadJson(make_base_file);
+  const ToleranceRequests requests =
+      MakeToleranceRequests(make_base, LoadJson(requests_file));
+  for (const auto& router_mode : ROUTER_MODES) {
+    for (const auto& graph_model : GRAPH_MODELS) {
+      std::vector<json::Node> answers;
+      for (const auto& current_program : {program, other_program}) {
+        const std::string name = "tolerance_"s + router_mode + "_"s +
+                                 graph_model + "_"s +
+                                 std::to_string(answers.size());
+        const Inputs inputs = WriteInputs(
+            make_base, requests.requests, name,
+            {{"router_mode"s, router_mode}, {"graph_model"s, graph_model}});
+        const std::string answers_file = name + "_answers.json"s;
+        Run(current_program, "make_base"s, inputs.make_base_file);
+        Run(current_program, "process_requests"s, inputs.requests_file,
+            answers_file);
+        answers.push_back(LoadJson(answers_file));
+      }
+      ToleranceChecker(requests, answers[0].AsArray(), answers[1].AsArray(),
+                       graph_model == "route_pattern"s,
+                       "The "s + router_mode + " mode of the "s + graph_model +
+                           " graph model"s)
+          .CheckAnswers();
+    }
+  }
+}
+
+}  // namespace test
+
+namespace {
+
+void PrintUsage() {
+  std::cerr << "Usage: transport_catalogue_tests TEST [ARGUMENTS]\n"
+               "  relax_row_kernels\n"
+               "  contraction_hierarchy\n"
+               "  hub_labels\n"
+               "  thread_counts PROGRAM MAKE_BASE_JSON REQUESTS_JSON\n"
+               "  weight_tolerance PROGRAM OTHER_PROGRAM MAKE_BASE_JSON "
+               "REQUESTS_JSON\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  using namespace std::literals;
+  if (argc < 2) {
+    PrintUsage();
+    return 1;
+  }
+  const std::string_view test_name(argv[1]);
+  try {
+    if (test_name == "relax_row_kernels"sv && argc == 2) {
+      test::TestRelaxRowKernels();
+    } else if (test_name == "contraction_hierarchy"sv && argc == 2) {
+      test::TestContractionHierarchy();
+    } else if (test_name == "hub_labels"sv && argc == 2) {
+      test::TestHubLabels();
+    } else if (test_name == "thread_counts"sv && argc == 5) {
+      test::TestThreadCounts(argv[2], argv[3], argv[4]);
+    } else if (test_name == "weight_tolerance"sv && argc == 6) {
+      test::TestWeightTolerance(argv[2], argv[3], argv[4], argv[5]);
+    } else {
+      PrintUsage();
+      return 1;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << test_name << ": " << e.what() << '\n';
+    return 1;
+  }
+  std::cout << test_name << ": OK\n";
+}
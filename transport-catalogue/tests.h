@@ -1 +1,31 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+#include <string>
+
+namespace test {
+
+// Every vectorized min-plus kernel the CPU can run gives the row of the
+// scalar one, for double and int32_t weights
+void TestRelaxRowKernels();
+// Routes of the contraction hierarchy and of the hub labels weigh as much as
+// the ones of Dijkstra's algorithm on small random graphs
+void TestContractionHierarchy();
+void TestHubLabels();
+
+// The tests below run built programs on a dataset: make_base_file holds the
+// base requests and settings, requests_file the stat requests. Their bases
+// and answers are written to the current directory.
+
+// Answers do not depend on the number of threads in any router mode, the
+// route and row caches included
+void TestThreadCounts(const std::string& program,
+                      const std::string& make_base_file,
+                      const std::string& requests_file);
+// Programs of the two weight types agree within 0.001 minutes per edge on
+// routes, route matrices and isochrones in every router mode
+void TestWeightTolerance(const std::string& program,
+                         const std::string& other_program,
+                         const std::string& make_base_file,
+                         const std::string& requests_file);
+
+}  // namespace test
@@ -0,0 +1,97 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace thread_pool {
+
+ThreadPool::ThreadPool(size_t thread_count) {
+  for (size_t i = 1; i < thread_count; ++i) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    is_stopped_ = true;
+  }
+  tasks_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::GetThreadCount() const { return workers_.size() + 1; }
+
+void ThreadPool::ParallelFor(size_t count,
+                             const std::function<void(size_t)>& func) {
+  if (workers_.empty() || count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_index{0};
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  std::exception_ptr error;
+  size_t running_helpers = std::min(workers_.size(), count - 1);
+
+  auto run = [&] {
+    try {
+      for (size_t i = next_index++; i < count; i = next_index++) {
+        func(i);
+      }
+    } catch (...) {
+      std::lock_guard lock(done_mutex);
+      if (!error) {
+        error = std::current_exception();
+      }
+      next_index = count;
+    }
+  };
+
+  {
+    std::lock_guard lock(mutex_);
+    for (size_t i = 0; i < running_helpers; ++i) {
+      tasks_.push([&] {
+        run();
+        std::lock_guard lock(done_mutex);
+        if (--running_helpers == 0) {
+          done_cv.notify_one();
+        }
+      });
+    }
+  }
+  tasks_cv_.notify_all();
+
+  run();
+  {
+    std::unique_lock lock(done_mutex);
+    done_cv.wait(lock, [&] { return running_helpers == 0; });
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(mutex_);
+      tasks_cv_.wait(lock, [this] { return is_stopped_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+
+}  // namespace thread_pool
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace thread_pool {
+
+class ThreadPool {
+ public:
+  // thread_count includes the calling thread, which takes part in every
+  // ParallelFor, so a pool of one thread runs everything inline
+  explicit ThreadPool(size_t thread_count);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  size_t GetThreadCount() const;
+
+  // Calls func(i) for every i in [0, count) and returns when all calls are
+  // done. The first exception thrown by func is rethrown to the caller.
+  // Must not be called from inside func.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+ private:
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable tasks_cv_;
+  bool is_stopped_ = false;
+};
+
+}  // namespace thread_pool
@@ -2,7 +2,9 @@
 
 #include <transport_catalogue.pb.h>
 
-#include <string>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
 #include <string_view>
 
 #include "domain.h"
@@ -10,15 +12,28 @@
 
 namespace catalogue {
 
+namespace {
+
+// Where the stop is or would be in distances sorted by stop id
+template <typename Distances>
+auto FindNeighbour(Distances& distances, StopId stop_id) {
+  return std::lower_bound(distances.begin(), distances.end(), stop_id,
+                          [](const std::pair<StopId, int>& distance,
+                             StopId id) { return distance.first < id; });
+}
+
+}  // namespace
+
 void TransportCatalogue::AddStopInternal(std::string_view name,
                                          geo::Coordinates coordinates,
                                          bool is_consistent) {
+  is_finalized_ = false;
   if (stopname_to_stop_.count(name) == 0) {
     stops_.emplace_back(Stop{static_cast<int>(stops_.size()),
-                             std::string{name},
+                             names_.Intern(name),
                              coordinates,
-                             {},
-                             is_consistent});
+                             is_consistent,
+                             {}});
     stopname_to_stop_[stops_.back().name] = &stops_.back();
     return;
   }
@@ -40,79 +55,203 @@ void TransportCatalogue::AddDraftStop(std::string_view name,
   AddStopInternal(name, coordinates, false);
 }
 
+// A bus of the same name is replaced and keeps its id
 void TransportCatalogue::AddBus(std::string_view bus_name,
                                 const std::vector<std::string_view>& stop_names,
                                 bool is_roundtrip) {
-  buses_.emplace_back(Bus{static_cast<int>(buses_.size()),
-                          std::string{bus_name},
-                          {},
-                          {},
-                          is_roundtrip});
+  is_finalized_ = false;
+  Bus* bus = nullptr;
+  if (busname_to_bus_.count(bus_name) == 0) {
+    buses_.emplace_back(Bus{static_cast<int>(buses_.size()),
+                            names_.Intern(bus_name),
+                            {},
+                            is_roundtrip,
+                            {}});
+    bus = &buses_.back();
+  } else {
+    bus = busname_to_bus_.at(bus_name);
+    bus->stops.clear();
+    bus->is_roundtrip = is_roundtrip;
+  }
   for (const auto& name : stop_names) {
     if (stopname_to_stop_.count(name) == 0) {
-      stops_.emplace_back(Stop{
-          static_cast<int>(stops_.size()), std::string{name}, {}, {}, false});
+      stops_.emplace_back(Stop{static_cast<int>(stops_.size()),
+                               names_.Intern(name),
+                               {},
+                               false,
+                               {}});
       stopname_to_stop_[stops_.back().name] = &stops_.back();
     }
 
-    Stop* stop = stopname_to_stop_.at(name);
-    buses_.back().stops.push_back(stop);
-    buses_.back().unique_stops.insert(stop);
-    stop->buses.insert(buses_.back().name);
+    bus->stops.push_back(stopname_to_stop_.at(name)->id);
+  }
+  busname_to_bus_[bus->name] = bus;
+}
+
+// Ids are positions in buses_, so the buses after the removed one move down
+// and the indices keyed by them are rebuilt. The name stays in the pool.
+void TransportCatalogue::RemoveBus(std::string_view bus_name) {
+  if (busname_to_bus_.count(bus_name) == 0) {
+    return;
+  }
+  is_finalized_ = false;
+  const int bus_id = busname_to_bus_.at(bus_name)->id;
+  busname_to_bus_.clear();
+  buses_.erase(buses_.begin() + bus_id);
+  for (size_t i = 0; i < buses_.size(); ++i) {
+    Bus& bus = buses_[i];
+    bus.id = static_cast<int>(i);
+    busname_to_bus_[bus.name] = &bus;
+  }
+}
+
+void TransportCatalogue::SetStopDistance(Stop& from, StopId to_id, int d) {
+  auto& distances = from.distances;
+  const auto it = FindNeighbour(distances, to_id);
+  if (it != distances.end() && it->first == to_id) {
+    it->second = d;
+  } else {
+    distances.insert(it, {to_id, d});
+  }
+}
+
+const int* TransportCatalogue::FindStopDistance(const Stop& from,
+                                                StopId to_id) {
+  const auto& distances = from.distances;
+  const auto it = FindNeighbour(distances, to_id);
+  if (it == distances.end() || it->first != to_id) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+size_t TransportCatalogue::GetStopDistance(const Stop& from,
+                                           const Stop& to) const {
+  if (const int* d = FindStopDistance(from, to.id)) {
+    return *d;
   }
-  busname_to_bus_[buses_.back().name] = &buses_.back();
+  if (const int* d = FindStopDistance(to, from.id)) {
+    return *d;
+  }
+  throw std::out_of_range("No distance between the stops");
 }
 
 void TransportCatalogue::SetDistance(std::string_view from, std::string_view to,
                                      int d) {
-  distances_[hasher_(from) + 2083 * hasher_(to)] = d;
+  is_finalized_ = false;
+  SetStopDistance(*stopname_to_stop_.at(from), stopname_to_stop_.at(to)->id,
+                  d);
+}
+
+
+TransportCatalogue::BusStats TransportCatalogue::ComputeBusStats(
+    const Bus& bus) const {
+  double geo_distance = 0.;
+  size_t road_distance = 0.;
+  for (size_t i = 1; i < bus.stops.size(); ++i) {
+    const Stop& from = stops_[bus.stops[i - 1]];
+    const Stop& to = stops_[bus.stops[i]];
+    geo_distance += geo::ComputeDistance(from.coordinates, to.coordinates);
+    road_distance += GetStopDistance(from, to);
+  }
+  return {static_cast<int>(road_distance), road_distance / geo_distance};
+}
+
+void TransportCatalogue::CheckFinalized() const {
+  if (!is_finalized_) {
+    throw std::logic_error("The catalogue is not finalized");
+  }
+}
+
+// Both indexes are counted first and filled after, so every one of them is
+// two flat arrays. Filling the stops' rows bus by bus in name order sorts
+// them.
+void TransportCatalogue::BuildIndexes() {
+  bus_stops_.offsets.assign(1, 0);
+  bus_stops_.items.clear();
+  for (const Bus& bus : buses_) {
+    auto& items = bus_stops_.items;
+    const auto row_begin = static_cast<std::ptrdiff_t>(items.size());
+    items.insert(items.end(), bus.stops.begin(), bus.stops.end());
+    std::sort(items.begin() + row_begin, items.end());
+    items.erase(std::unique(items.begin() + row_begin, items.end()),
+                items.end());
+    bus_stops_.offsets.push_back(static_cast<uint32_t>(items.size()));
+  }
+  bus_stops_.items.shrink_to_fit();
+
+  stop_buses_.offsets.assign(stops_.size() + 1, 0);
+  for (const StopId stop : bus_stops_.items) {
+    ++stop_buses_.offsets[stop + 1];
+  }
+  for (size_t i = 0; i < stops_.size(); ++i) {
+    stop_buses_.offsets[i + 1] += stop_buses_.offsets[i];
+  }
+  std::vector<const Bus*> buses_by_name;
+  for (const Bus& bus : buses_) {
+    buses_by_name.push_back(&bus);
+  }
+  std::sort(buses_by_name.begin(), buses_by_name.end(),
+            [](const Bus* lhs, const Bus* rhs) {
+              return lhs->name < rhs->name;
+            });
+  std::vector<uint32_t> positions(stop_buses_.offsets.begin(),
+                                  stop_buses_.offsets.end() - 1);
+  stop_buses_.items.assign(bus_stops_.items.size(), {});
+  stop_buses_.items.shrink_to_fit();
+  for (const Bus* bus : buses_by_name) {
+    for (uint32_t i = bus_stops_.offsets[bus->id];
+         i < bus_stops_.offsets[bus->id + 1]; ++i) {
+      stop_buses_.items[positions[bus_stops_.items[i]]++] = bus->name;
+    }
+  }
 }
 
-// Existence required
-size_t TransportCatalogue::GetDistance(std::string_view from,
-                                       std::string_view to) const {
-  size_t hash = hasher_(from) + 2083 * hasher_(to);
-  if (distances_.count(hash) == 1) {
-    return distances_.at(hash);
+void TransportCatalogue::Finalize() {
+  if (is_finalized_) {
+    return;
+  }
+  BuildIndexes();
+  for (Bus& bus : buses_) {
+    bus.stats = ComputeBusStats(bus);
   }
-  return distances_.at(hasher_(to) + 2083 * hasher_(from));
+  is_finalized_ = true;
 }
 
 BusInfo TransportCatalogue::GetBusInfo(std::string_view name) const {
+  CheckFinalized();
   if (busname_to_bus_.count(name) == 0) {
     return {name, {}, {}, {}, {}, false};
   }
   const Bus* bus = busname_to_bus_.at(name);
-  // distance calculation
-  double geo_distance = 0.;
-  size_t road_distance = 0.;
-  for (size_t i = 1; i < bus->stops.size(); ++i) {
-    geo_distance += geo::ComputeDistance(bus->stops[i - 1]->coordinates,
-                                         bus->stops[i]->coordinates);
-    road_distance += GetDistance(bus->stops[i - 1]->name, bus->stops[i]->name);
-  }
-
   return {bus->name,
           static_cast<int>(bus->stops.size()),
-          static_cast<int>(bus->unique_stops.size()),
-          static_cast<int>(road_distance),
-          road_distance / geo_distance,
+          static_cast<int>(bus_stops_.offsets[bus->id + 1] -
+                           bus_stops_.offsets[bus->id]),
+          bus->stats.route_length,
+          bus->stats.curvature,
           true};
 }
 
 StopInfo TransportCatalogue::GetStopInfo(std::string_view name) const {
+  CheckFinalized();
   if (stopname_to_stop_.count(name) == 0) {
-    return {name, {}, false};
+    return {name, {nullptr, nullptr}, false};
   }
   const Stop* stop = stopname_to_stop_.at(name);
-  return {stop->name, stop->buses, true};
+  const std::string_view* buses = stop_buses_.items.data();
+  return {stop->name,
+          {buses + stop_buses_.offsets[stop->id],
+           buses + stop_buses_.offsets[stop->id + 1]},
+          true};
 }
 
 std::vector<std::string_view> TransportCatalogue::GetReachableStopNames()
     const {
+  CheckFinalized();
   std::vector<std::string_view> result;
   for (const auto& stop : stops_) {
-    if (!stop.buses.empty()) {
+    if (stop_buses_.offsets[stop.id + 1] > stop_buses_.offsets[stop.id]) {
       result.push_back(stop.name);
     }
   }
@@ -127,29 +266,43 @@ std::vector<std::string_view> TransportCatalogue::GetBusNames() const {
   return result;
 }
 
-std::vector<std::string_view> TransportCatalogue::GetStopsForBus(
+std::optional<StopId> TransportCatalogue::FindStop(
     std::string_view name) const {
-  if (busname_to_bus_.count(name) == 0) {
-    return {};
-  }
-  std::vector<std::string_view> result;
-  const auto& stops = busname_to_bus_.at(name)->stops;
-  for (const auto& stop : stops) {
-    result.push_back(stop->name);
+  const auto it = stopname_to_stop_.find(name);
+  if (it == stopname_to_stop_.end()) {
+    return std::nullopt;
   }
-  return result;
+  return it->second->id;
 }
 
-geo::Coordinates TransportCatalogue::GetCoordinates(
-    std::string_view name) const {
-  if (stopname_to_stop_.count(name) == 0) {
-    return {};
+std::optional<BusId> TransportCatalogue::FindBus(std::string_view name) const {
+  const auto it = busname_to_bus_.find(name);
+  if (it == busname_to_bus_.end()) {
+    return std::nullopt;
   }
-  return stopname_to_stop_.at(name)->coordinates;
+  return it->second->id;
+}
+
+size_t TransportCatalogue::GetStopCount() const { return stops_.size(); }
+
+std::string_view TransportCatalogue::GetStopName(StopId id) const {
+  return stops_[id].name;
+}
+
+geo::Coordinates TransportCatalogue::GetCoordinates(StopId id) const {
+  return stops_[id].coordinates;
+}
+
+const std::vector<StopId>& TransportCatalogue::GetBusStops(BusId id) const {
+  return buses_[id].stops;
+}
+
+bool TransportCatalogue::IsRoundTrip(BusId id) const {
+  return buses_[id].is_roundtrip;
 }
 
-bool TransportCatalogue::IsRoundTrip(std::string_view name) const {
-  return busname_to_bus_.at(name)->is_roundtrip;
+size_t TransportCatalogue::GetDistance(StopId from, StopId to) const {
+  return GetStopDistance(stops_[from], stops_[to]);
 }
 
 }  // namespace catalogue
\ No newline at end of file
@@ -2,24 +2,26 @@
 
 #include <transport_catalogue.pb.h>
 
+#include <cstdint>
 #include <deque>
-#include <functional>
-#include <set>
-#include <string>
+#include <optional>
 #include <string_view>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "domain.h"
 #include "geo.h"
+#include "ranges.h"
 #include "serialization.h"
+#include "string_pool.h"
 
 namespace catalogue {
 
 struct StopInfo {
   std::string_view name;
-  const std::set<std::string_view>& buses;
+  // Names of the buses through the stop, sorted
+  ranges::Range<const std::string_view*> buses;
   bool is_found = false;
 };
 
@@ -32,6 +34,11 @@ struct BusInfo {
   bool is_found = false;
 };
 
+// Stops and buses are numbered from zero in the order they were added.
+// Removing a bus renumbers the buses after it.
+using StopId = int;
+using BusId = int;
+
 class TransportCatalogue {
  public:
   void AddStop(std::string_view name, geo::Coordinates coordinates);
@@ -39,16 +46,30 @@ class TransportCatalogue {
   void AddBus(std::string_view bus_name,
               const std::vector<std::string_view>& stop_names,
               bool is_roundtrip);
+  void RemoveBus(std::string_view bus_name);
+  // Both stops must exist
   void SetDistance(std::string_view from, std::string_view to, int d);
-  size_t GetDistance(std::string_view from, std::string_view to) const;
+  // Builds the stop and bus indexes and the statistics of every bus. Any
+  // later change drops them until the next call.
+  void Finalize();
+  // These three need a finalized catalogue and throw logic_error otherwise
   BusInfo GetBusInfo(std::string_view name) const;
   StopInfo GetStopInfo(std::string_view name) const;
   std::vector<std::string_view> GetReachableStopNames() const;
   std::vector<std::string_view> GetBusNames() const;
-  std::vector<std::string_view> GetStopsForBus(std::string_view name) const;
-  geo::Coordinates GetCoordinates(std::string_view name) const;
-  bool IsRoundTrip(std::string_view name) const;
-  
+
+  // Names are resolved to ids once, the accessors by id hash no strings.
+  // Ids must be valid.
+  std::optional<StopId> FindStop(std::string_view name) const;
+  std::optional<BusId> FindBus(std::string_view name) const;
+  size_t GetStopCount() const;
+  std::string_view GetStopName(StopId id) const;
+  geo::Coordinates GetCoordinates(StopId id) const;
+  const std::vector<StopId>& GetBusStops(BusId id) const;
+  bool IsRoundTrip(BusId id) const;
+  // The distance from one stop to the other, or else back
+  size_t GetDistance(StopId from, StopId to) const;
+
   friend class serialization::Saver;
   friend class serialization::Loader;
 
@@ -57,27 +78,54 @@ class TransportCatalogue {
                        bool is_consistent);
 
   struct Stop {
-    int id;
-    std::string name;
+    StopId id;
+    std::string_view name;
     geo::Coordinates coordinates;
-    std::set<std::string_view> buses;
     bool is_consistent = false;
+    // Road distances to other stops as (stop id, meters), sorted by id
+    std::vector<std::pair<StopId, int>> distances;
+  };
+
+  struct BusStats {
+    int route_length = 0;
+    double curvature = 0.;
   };
 
   struct Bus {
-    int id;
-    std::string name;
-    std::vector<Stop*> stops;
-    std::unordered_set<Stop*> unique_stops;
+    BusId id;
+    std::string_view name;
+    std::vector<StopId> stops;
     bool is_roundtrip;
+    // Valid while the catalogue is finalized
+    BusStats stats;
   };
 
+  // Items of row i are from offsets[i] to offsets[i + 1]
+  template <typename Item>
+  struct FlatIndex {
+    std::vector<uint32_t> offsets;
+    std::vector<Item> items;
+  };
+
+  void CheckFinalized() const;
+  void BuildIndexes();
+  BusStats ComputeBusStats(const Bus& bus) const;
+
+  static void SetStopDistance(Stop& from, StopId to_id, int d);
+  static const int* FindStopDistance(const Stop& from, StopId to_id);
+  size_t GetStopDistance(const Stop& from, const Stop& to) const;
+
+  // Owns the names of the stops and buses, which every other name views
+  string_pool::StringPool names_;
   std::deque<Stop> stops_;
   std::deque<Bus> buses_;
   std::unordered_map<std::string_view, Stop*> stopname_to_stop_;
   std::unordered_map<std::string_view, Bus*> busname_to_bus_;
-  std::unordered_map<size_t, int> distances_;
-  std::hash<std::string_view> hasher_;
+  // Distinct stops of every bus sorted by id, and names of the buses through
+  // every stop sorted by name, both valid while the catalogue is finalized
+  FlatIndex<StopId> bus_stops_;
+  FlatIndex<std::string_view> stop_buses_;
+  bool is_finalized_ = false;
 };
 
 }  // namespace catalogue
\ No newline at end of file
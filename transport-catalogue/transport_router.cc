@@ -1,7 +1,14 @@
 #include "transport_router.h"
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
 #include <optional>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -10,47 +17,401 @@
 
 namespace transport_router {
 
-TransportRouter::TransportRouter(RoutingSettings rs, const TrCat& tc)
+TransportRouter::TransportRouter(RoutingSettings rs, const TrCat& tc,
+                                 size_t thread_count)
     : routing_settings_(rs),
-      graph_{std::move(BuildVertexMapEdgeMapAndGraph(tc))},
-      router_{graph_} {}
+      graph_{BuildVertexMapEdgeMapAndGraph(tc, thread_count)},
+      router_{graph_, routing_settings_.router_mode == RouterMode::PRECOMPUTED,
+              thread_count},
+      contraction_hierarchy_{graph_, routing_settings_.router_mode ==
+                                         RouterMode::CONTRACTION_HIERARCHY},
+      hub_labels_{graph_,
+                  routing_settings_.router_mode == RouterMode::HUB_LABELS} {
+  InitializeSearch(tc);
+}
 
 TransportRouter::TransportRouter(Graph&& g)
-    : graph_{std::move(g)}, router_(graph_, false) {}
+    : graph_{std::move(g)},
+      router_(graph_, false),
+      contraction_hierarchy_(graph_, false),
+      hub_labels_(graph_, false) {}
 
 Graph TransportRouter::BuildVertexMapEdgeMapAndGraph(
-    const TrCat& transport_catalogue) {
-  auto reachable_stop_names = transport_catalogue.GetReachableStopNames();
-  size_t stop_count = reachable_stop_names.size();
+    const TrCat& transport_catalogue, size_t thread_count) {
+  if (routing_settings_.router_mode == RouterMode::RAPTOR) {
+    InitializeNames(transport_catalogue);
+    return BuildStopGraph();
+  }
+  thread_pool::ThreadPool pool(thread_count);
+  Graph graph = routing_settings_.graph_model == GraphModel::ROUTE_PATTERN
+                    ? BuildRoutePatternGraph(transport_catalogue, pool)
+                    : BuildCompleteGraph(transport_catalogue, pool);
+  // Freezing renumbers the edges, their infos follow
+  const std::vector<graph::EdgeId> new_ids = graph.Freeze();
+  std::vector<EdgeInfo> edge_infos(edge_infos_.size());
+  for (graph::EdgeId edge_id = 0; edge_id < new_ids.size(); ++edge_id) {
+    edge_infos[new_ids[edge_id]] = edge_infos_[edge_id];
+  }
+  edge_infos_ = std::move(edge_infos);
+  return graph;
+}
+
+// Raptor searches the buses themselves, so its graph has a vertex per stop,
+// numbered as the stops, and no edges
+Graph TransportRouter::BuildStopGraph() {
+  for (size_t i = 0; i < stop_names_.size(); ++i) {
+    stop_name_to_vertex_id_.insert({stop_names_[i], i});
+  }
+  Graph graph(stop_names_.size());
+  graph.Freeze();
+  return graph;
+}
+
+// Stops and buses are numbered by name, not by the catalogue's ids, which
+// depend on the order of the requests and on removals. A catalogue updated
+// in place then gives the same graph, and breaks ties between equal routes
+// the same way, as one built anew with the same stops and buses.
+void TransportRouter::InitializeNames(const TrCat& transport_catalogue) {
+  stop_names_ = transport_catalogue.GetReachableStopNames();
+  std::sort(stop_names_.begin(), stop_names_.end());
+  bus_names_ = transport_catalogue.GetBusNames();
+  std::sort(bus_names_.begin(), bus_names_.end());
+}
+
+// Router stop indices by catalogue stop id
+std::vector<uint32_t> TransportRouter::GetStopIndices(
+    const TrCat& transport_catalogue) const {
+  std::vector<uint32_t> stop_indices(transport_catalogue.GetStopCount());
+  for (uint32_t i = 0; i < stop_names_.size(); ++i) {
+    stop_indices[*transport_catalogue.FindStop(stop_names_[i])] = i;
+  }
+  return stop_indices;
+}
+
+TransportRouter::BusStops TransportRouter::ResolveBus(
+    const TrCat& transport_catalogue, const std::vector<uint32_t>& stop_indices,
+    size_t bus_id) const {
+  const auto& stop_ids = transport_catalogue.GetBusStops(
+      *transport_catalogue.FindBus(bus_names_[bus_id]));
+  BusStops bus;
+  for (size_t i = 0; i < stop_ids.size(); ++i) {
+    bus.stops.push_back(stop_indices[stop_ids[i]]);
+    if (i > 0) {
+      bus.segment_times.push_back(
+          transport_catalogue.GetDistance(stop_ids[i - 1], stop_ids[i]) *
+          .06 / routing_settings_.bus_velocity);
+    }
+  }
+  return bus;
+}
+
+// Every bus resolves its stops and distances by catalogue stop id once, in
+// parallel with the other buses
+std::vector<TransportRouter::BusStops> TransportRouter::ResolveBuses(
+    const TrCat& transport_catalogue, thread_pool::ThreadPool& pool) const {
+  const std::vector<uint32_t> stop_indices =
+      GetStopIndices(transport_catalogue);
+  std::vector<BusStops> buses(bus_names_.size());
+  pool.ParallelFor(bus_names_.size(), [&](size_t bus_id) {
+    buses[bus_id] = ResolveBus(transport_catalogue, stop_indices, bus_id);
+  });
+  return buses;
+}
+
+std::vector<TransportRouter::BusStops> TransportRouter::ResolveBuses(
+    const TrCat& transport_catalogue) const {
+  const std::vector<uint32_t> stop_indices =
+      GetStopIndices(transport_catalogue);
+  std::vector<BusStops> buses;
+  buses.reserve(bus_names_.size());
+  for (size_t bus_id = 0; bus_id < bus_names_.size(); ++bus_id) {
+    buses.push_back(ResolveBus(transport_catalogue, stop_indices, bus_id));
+  }
+  return buses;
+}
+
+// An edge of no route's weight would read as missing and sums past it would
+// wrap, so such weights are rejected rather than added
+graph::EdgeId TransportRouter::AddEdge(Graph& graph, const EdgeStruct& edge,
+                                       EdgeInfo info) {
+  if (!(edge.weight < INFINITE_WEIGHT)) {
+    throw std::out_of_range("Edge weight is out of range");
+  }
+  const graph::EdgeId edge_id = graph.AddEdge(edge);
+  edge_infos_.push_back(info);
+  return edge_id;
+}
+
+// Batches are added in bus order, so edge ids do not depend on the number
+// of threads
+void TransportRouter::AddEdges(Graph& graph,
+                               const std::vector<EdgeBatch>& batches) {
+  for (const auto& batch : batches) {
+    for (size_t i = 0; i < batch.edges.size(); ++i) {
+      AddEdge(graph, batch.edges[i], batch.infos[i]);
+    }
+  }
+}
+
+Graph TransportRouter::BuildCompleteGraph(const TrCat& transport_catalogue,
+                                          thread_pool::ThreadPool& pool) {
+  InitializeNames(transport_catalogue);
+  const std::vector<BusStops> buses = ResolveBuses(transport_catalogue, pool);
+  const size_t stop_count = stop_names_.size();
+  const Weight wait_time = ToWeight(routing_settings_.bus_wait_time);
   Graph graph(2 * stop_count);
-  for (size_t i = 0; i < stop_count; ++i) {
-    stop_name_to_vertex_id_.insert({reachable_stop_names[i], 2 * i});
-    graph::EdgeId edge_id = graph.AddEdge(
-        EdgeStruct{2 * i, 2 * i + 1, 1.0 * routing_settings_.bus_wait_time});
-    edge_id_to_route_element_.insert({edge_id, Wait{reachable_stop_names[i]}});
-  }
-  for (const auto& bus : transport_catalogue.GetBusNames()) {
-    auto stop_names_for_bus = transport_catalogue.GetStopsForBus(bus);
-    size_t stop_names_for_bus_count = stop_names_for_bus.size();
-    for (size_t i = 0; i < stop_names_for_bus_count; ++i) {
-      int span_count = 0;
+  for (uint32_t i = 0; i < stop_count; ++i) {
+    stop_name_to_vertex_id_.insert({stop_names_[i], 2 * i});
+    AddEdge(graph, EdgeStruct{2 * i, 2 * i + 1, wait_time},
+            {i, 0, EdgeKind::WAIT});
+  }
+  std::vector<EdgeBatch> batches(buses.size());
+  pool.ParallelFor(buses.size(), [&](size_t bus_id) {
+    const auto& stops = buses[bus_id].stops;
+    const auto& segment_times = buses[bus_id].segment_times;
+    if (stops.size() > std::numeric_limits<uint16_t>::max()) {
+      throw std::length_error("Too many stops for the complete graph model");
+    }
+    EdgeBatch& batch = batches[bus_id];
+    for (size_t i = 0; i < stops.size(); ++i) {
+      uint16_t span_count = 0;
       double time = 0.;
-      for (size_t j = i + 1; j < stop_names_for_bus_count; ++j) {
+      for (size_t j = i + 1; j < stops.size(); ++j) {
         ++span_count;
-        time += transport_catalogue.GetDistance(stop_names_for_bus[j - 1],
-                                                stop_names_for_bus[j]) *
-                .06 / routing_settings_.bus_velocity;
-        graph::VertexId from =
-            stop_name_to_vertex_id_.at(stop_names_for_bus[i]) + 1;
-        graph::VertexId to = stop_name_to_vertex_id_.at(stop_names_for_bus[j]);
-        graph::EdgeId edge_id = graph.AddEdge(EdgeStruct{from, to, time});
-        edge_id_to_route_element_.insert({edge_id, Bus{bus, span_count, time}});
+        time += segment_times[j - 1];
+        batch.edges.push_back(
+            {2 * stops[i] + 1, 2 * stops[j], ToWeight(time)});
+        batch.infos.push_back(
+            {static_cast<uint32_t>(bus_id), span_count, EdgeKind::BUS});
       }
     }
+  });
+  AddEdges(graph, batches);
+  return graph;
+}
+
+// Every stop has one vertex, and every stop of every bus has an on-vehicle
+// vertex. Boarding edges from a stop to the bus take the wait time and stand
+// for Wait, ride edges to the next stop of the bus stand for Bus with
+// span_count 1, alighting edges back to the stop are free and stand for
+// nothing. BuildRoute merges the rides between boarding and alighting into
+// one Bus.
+Graph TransportRouter::BuildRoutePatternGraph(
+    const TrCat& transport_catalogue, thread_pool::ThreadPool& pool) {
+  InitializeNames(transport_catalogue);
+  const std::vector<BusStops> buses = ResolveBuses(transport_catalogue, pool);
+  const Weight wait_time = ToWeight(routing_settings_.bus_wait_time);
+  // On-vehicle vertices of a bus follow the ones of the previous buses
+  std::vector<graph::VertexId> first_on_vehicle;
+  size_t vertex_count = stop_names_.size();
+  for (const auto& bus : buses) {
+    first_on_vehicle.push_back(vertex_count);
+    vertex_count += bus.stops.size();
+  }
+
+  Graph graph(vertex_count);
+  for (size_t i = 0; i < stop_names_.size(); ++i) {
+    stop_name_to_vertex_id_.insert({stop_names_[i], i});
   }
+  std::vector<EdgeBatch> batches(buses.size());
+  pool.ParallelFor(buses.size(), [&](size_t bus_id) {
+    const auto& stops = buses[bus_id].stops;
+    EdgeBatch& batch = batches[bus_id];
+    graph::VertexId on_vehicle = first_on_vehicle[bus_id];
+    for (size_t i = 0; i < stops.size(); ++i, ++on_vehicle) {
+      const uint32_t stop = stops[i];
+      if (i + 1 < stops.size()) {
+        batch.edges.push_back({stop, on_vehicle, wait_time});
+        batch.infos.push_back({stop, 0, EdgeKind::WAIT});
+        batch.edges.push_back(
+            {on_vehicle, on_vehicle + 1,
+             ToWeight(buses[bus_id].segment_times[i])});
+        batch.infos.push_back(
+            {static_cast<uint32_t>(bus_id), 1, EdgeKind::BUS});
+      }
+      if (i > 0) {
+        batch.edges.push_back({on_vehicle, stop, Weight{}});
+        batch.infos.push_back({0, 0, EdgeKind::NONE});
+      }
+    }
+  });
+  AddEdges(graph, batches);
   return graph;
 }
 
+void TransportRouter::Update(const TrCat& tc, size_t thread_count) {
+  const Graph old_graph = std::move(graph_);
+  const std::vector<EdgeInfo> old_edge_infos = std::move(edge_infos_);
+  // Owned copies, the old names may be gone from the changed catalogue
+  const std::vector<std::string> old_stop_names(stop_names_.begin(),
+                                                stop_names_.end());
+  const std::vector<std::string> old_bus_names(bus_names_.begin(),
+                                               bus_names_.end());
+  edge_infos_.clear();
+  stop_name_to_vertex_id_.clear();
+  graph_ = BuildVertexMapEdgeMapAndGraph(tc, thread_count);
+
+  switch (routing_settings_.router_mode) {
+    case RouterMode::PRECOMPUTED:
+      // Vertices of the complete graph model are the stops only
+      if (routing_settings_.graph_model == GraphModel::COMPLETE &&
+          std::equal(stop_names_.begin(), stop_names_.end(),
+                     old_stop_names.begin(), old_stop_names.end())) {
+        router_.UpdateRoutes(
+            old_graph, MatchEdges(old_graph, old_edge_infos, old_bus_names),
+            thread_count);
+      } else {
+        router_.PrecomputeRoutes(thread_count);
+      }
+      break;
+    case RouterMode::CONTRACTION_HIERARCHY:
+      contraction_hierarchy_.Rebuild();
+      break;
+    case RouterMode::HUB_LABELS:
+      hub_labels_.Rebuild();
+      break;
+    default:
+      break;
+  }
+  InitializeSearch(tc);
+}
+
+// An edge is the same if it joins the same vertices with the same stop or
+// bus and span count. Equal edges of one bus are matched in order.
+std::vector<graph::EdgeId> TransportRouter::MatchEdges(
+    const Graph& old_graph, const std::vector<EdgeInfo>& old_edge_infos,
+    const std::vector<std::string>& old_bus_names) const {
+  using EdgeKey =
+      std::tuple<graph::VertexId, graph::VertexId, std::string_view, uint16_t>;
+  const auto get_key = [](const EdgeStruct& edge, const EdgeInfo& info,
+                          const auto& bus_names) {
+    return EdgeKey{edge.from, edge.to,
+                   info.kind == EdgeKind::BUS
+                       ? std::string_view{bus_names[info.element_id]}
+                       : std::string_view{},
+                   info.span_count};
+  };
+  // Ids are pushed in reverse, so the first one is at the back
+  std::map<EdgeKey, std::vector<graph::EdgeId>> new_edge_ids_by_key;
+  for (graph::EdgeId edge_id = graph_.GetEdgeCount(); edge_id-- > 0;) {
+    new_edge_ids_by_key[get_key(graph_.GetEdge(edge_id), edge_infos_[edge_id],
+                                bus_names_)]
+        .push_back(edge_id);
+  }
+  std::vector<graph::EdgeId> new_edge_ids(old_graph.GetEdgeCount(),
+                                          graph::Router<Weight>::NO_EDGE);
+  for (graph::EdgeId edge_id = 0; edge_id < old_graph.GetEdgeCount();
+       ++edge_id) {
+    const auto it = new_edge_ids_by_key.find(get_key(
+        old_graph.GetEdge(edge_id), old_edge_infos[edge_id], old_bus_names));
+    if (it != new_edge_ids_by_key.end() && !it->second.empty()) {
+      new_edge_ids[edge_id] = it->second.back();
+      it->second.pop_back();
+    }
+  }
+  return new_edge_ids;
+}
+
+void TransportRouter::InitializeSearch(const TrCat& transport_catalogue) {
+  if (routing_settings_.router_mode == RouterMode::A_STAR) {
+    InitializeAStar(transport_catalogue);
+  }
+  if (routing_settings_.router_mode == RouterMode::BIDIRECTIONAL) {
+    graph_.BuildReverseIncidenceLists();
+  }
+  if (routing_settings_.router_mode == RouterMode::RAPTOR) {
+    InitializeRaptor(transport_catalogue);
+  }
+  route_cache_.Reset(routing_settings_.route_cache_size);
+  row_cache_.Reset(routing_settings_.router_mode == RouterMode::LAZY_ROWS
+                       ? routing_settings_.row_cache_size
+                       : 0);
+}
+
+// The A* heuristic is the great-circle distance to the destination divided by
+// the highest speed along an edge, in meters per weight unit. Road distances
+// may be shorter than great-circle ones, so the speed is taken from the
+// graph, not from the settings.
+void TransportRouter::InitializeAStar(const TrCat& transport_catalogue) {
+  vertex_coordinates_.assign(graph_.GetVertexCount(), {});
+  for (const auto& [stop_name, vertex_id] : stop_name_to_vertex_id_) {
+    vertex_coordinates_[vertex_id] = transport_catalogue.GetCoordinates(
+        *transport_catalogue.FindStop(stop_name));
+  }
+  // The other vertices stand at a stop: a Wait edge leads there from the
+  // stop, or an alighting edge leads from there to the stop
+  for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    const auto edge = graph_.GetEdge(edge_id);
+    if (edge_infos_[edge_id].kind == EdgeKind::NONE) {
+      vertex_coordinates_[edge.from] = vertex_coordinates_[edge.to];
+    } else if (edge_infos_[edge_id].kind == EdgeKind::WAIT) {
+      vertex_coordinates_[edge.to] = vertex_coordinates_[edge.from];
+    }
+  }
+  max_velocity_ = 0.;
+  for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    const auto edge = graph_.GetEdge(edge_id);
+    const double distance = geo::ComputeDistance(
+        vertex_coordinates_[edge.from], vertex_coordinates_[edge.to]);
+    if (distance > 0.) {
+      max_velocity_ =
+          std::max(max_velocity_, distance / static_cast<double>(edge.weight));
+    }
+  }
+  // Leaves room for rounding errors of geo::ComputeDistance
+  max_velocity_ *= 1.001;
+}
+
+// Raptor runs on the stop sequences of the buses, its stops are the vertices
+// of the graph. The buses are resolved on the calling thread, as a loaded
+// router has no pool.
+void TransportRouter::InitializeRaptor(const TrCat& transport_catalogue) {
+  std::vector<raptor::Route> routes;
+  for (auto& bus : ResolveBuses(transport_catalogue)) {
+    routes.push_back({{bus.stops.begin(), bus.stops.end()},
+                      std::move(bus.segment_times)});
+  }
+  raptor_ = raptor::Raptor(stop_names_.size(), std::move(routes),
+                           routing_settings_.bus_wait_time);
+}
+
+RouteInfo TransportRouter::MakeRouteInfo(
+    const raptor::Journey& journey) const {
+  std::vector<RouteElement> items;
+  for (const auto& leg : journey.legs) {
+    const auto& route = raptor_.GetRoute(leg.route);
+    items.push_back(Wait{stop_names_[route.stops[leg.board_position]]});
+    items.push_back(Bus{bus_names_[leg.route],
+                        static_cast<int>(leg.alight_position -
+                                         leg.board_position),
+                        leg.ride_time});
+  }
+  return {journey.weight, std::move(items)};
+}
+
+std::vector<RouteInfo> TransportRouter::BuildRouteAlternatives(
+    std::string_view from, std::string_view to) const {
+  if (routing_settings_.router_mode != RouterMode::RAPTOR || from == to) {
+    auto route_info = BuildRoute(from, to);
+    if (!route_info) {
+      return {};
+    }
+    return {std::move(*route_info)};
+  }
+  const auto from_it = stop_name_to_vertex_id_.find(from);
+  const auto to_it = stop_name_to_vertex_id_.find(to);
+  if (from_it == stop_name_to_vertex_id_.end() ||
+      to_it == stop_name_to_vertex_id_.end()) {
+    return {};
+  }
+  std::vector<RouteInfo> alternatives;
+  for (const auto& journey :
+       raptor_.FindParetoJourneys(from_it->second, to_it->second)) {
+    alternatives.push_back(MakeRouteInfo(journey));
+  }
+  return alternatives;
+}
+
 std::optional<RouteInfo> TransportRouter::BuildRoute(
     std::string_view from, std::string_view to) const {
   if (from == to) {
@@ -60,21 +421,215 @@ std::optional<RouteInfo> TransportRouter::BuildRoute(
       stop_name_to_vertex_id_.count(to) == 0) {
     return std::nullopt;
   }
-  auto route_info = router_.BuildRoute(stop_name_to_vertex_id_.at(from),
-                                       stop_name_to_vertex_id_.at(to));
+  const graph::VertexId from_id = stop_name_to_vertex_id_.at(from);
+  const graph::VertexId to_id = stop_name_to_vertex_id_.at(to);
+  if (!route_cache_.IsEnabled()) {
+    return BuildRouteInfo(from_id, to_id);
+  }
+  const RouteCacheKey key = static_cast<RouteCacheKey>(from_id) << 32 | to_id;
+  if (auto cached = route_cache_.Find(key)) {
+    return std::move(*cached);
+  }
+  auto route_info = BuildRouteInfo(from_id, to_id);
+  route_cache_.Insert(key, route_info);
+  return route_info;
+}
+
+std::optional<RouteInfo> TransportRouter::BuildRouteInfo(
+    graph::VertexId from, graph::VertexId to) const {
+  if (routing_settings_.router_mode == RouterMode::RAPTOR) {
+    const auto journey = raptor_.FindJourney(from, to);
+    if (!journey) {
+      return std::nullopt;
+    }
+    return MakeRouteInfo(*journey);
+  }
+  auto route_info = FindRoute(from, to);
   if (!route_info) {
     return std::nullopt;
   }
   std::vector<RouteElement> items;
+  // Rides of the route pattern model are merged until the next alighting
+  // edge. The complete model never has two Bus items in a row.
+  bool is_riding = false;
   for (const auto& edge_id : route_info.value().edges) {
-    const auto& element = edge_id_to_route_element_.at(edge_id);
-    items.push_back(element);
+    const EdgeInfo& info = edge_infos_[edge_id];
+    const double time = ToMinutes(graph_.GetEdge(edge_id).weight);
+    switch (info.kind) {
+      case EdgeKind::NONE:
+        is_riding = false;
+        break;
+      case EdgeKind::WAIT:
+        items.push_back(Wait{stop_names_[info.element_id]});
+        is_riding = false;
+        break;
+      case EdgeKind::BUS:
+        if (is_riding) {
+          auto& ride = std::get<Bus>(items.back());
+          ride.span_count += info.span_count;
+          ride.time += time;
+        } else {
+          items.push_back(
+              Bus{bus_names_[info.element_id], info.span_count, time});
+        }
+        is_riding = true;
+        break;
+    }
+  }
+  return RouteInfo{ToMinutes(route_info->weight), std::move(items)};
+}
+
+RouteMatrix TransportRouter::BuildRouteMatrix(
+    const std::vector<std::string_view>& from,
+    const std::vector<std::string_view>& to) const {
+  // Unknown destinations are left out of the searches
+  std::vector<graph::VertexId> targets;
+  std::vector<std::optional<size_t>> target_indices;
+  for (const auto& stop_name : to) {
+    const auto it = stop_name_to_vertex_id_.find(stop_name);
+    if (it == stop_name_to_vertex_id_.end()) {
+      target_indices.push_back(std::nullopt);
+    } else {
+      target_indices.push_back(targets.size());
+      targets.push_back(it->second);
+    }
+  }
+
+  RouteMatrix matrix;
+  matrix.reserve(from.size());
+  for (const auto& stop_name : from) {
+    auto& row = matrix.emplace_back(to.size());
+    const auto it = stop_name_to_vertex_id_.find(stop_name);
+    if (it == stop_name_to_vertex_id_.end()) {
+      continue;
+    }
+    if (routing_settings_.router_mode == RouterMode::RAPTOR) {
+      // One search reaches every destination, in minutes already
+      const auto arrivals = raptor_.FindArrivals(it->second);
+      for (size_t i = 0; i < to.size(); ++i) {
+        if (target_indices[i] &&
+            arrivals[targets[*target_indices[i]]] !=
+                std::numeric_limits<double>::infinity()) {
+          row[i] = arrivals[targets[*target_indices[i]]];
+        }
+      }
+      continue;
+    }
+    std::vector<std::optional<Weight>> weights;
+    if (routing_settings_.router_mode == RouterMode::HUB_LABELS) {
+      // Label merges need no search and no route edges
+      for (const graph::VertexId target : targets) {
+        weights.push_back(hub_labels_.BuildRouteWeight(it->second, target));
+      }
+    } else if (routing_settings_.router_mode == RouterMode::LAZY_ROWS) {
+      weights = router_.BuildRouteWeights(*GetRouteRow(it->second), targets);
+    } else {
+      weights = router_.BuildRouteWeights(it->second, targets);
+    }
+    for (size_t i = 0; i < to.size(); ++i) {
+      if (target_indices[i] && weights[*target_indices[i]]) {
+        row[i] = ToMinutes(*weights[*target_indices[i]]);
+      }
+    }
+  }
+  // Same as BuildRoute, a stop is reachable from itself even if no bus stops
+  // there
+  for (size_t i = 0; i < from.size(); ++i) {
+    for (size_t j = 0; j < to.size(); ++j) {
+      if (from[i] == to[j]) {
+        matrix[i][j] = 0.;
+      }
+    }
+  }
+  return matrix;
+}
+
+std::optional<std::vector<ReachableStop>> TransportRouter::BuildIsochrone(
+    std::string_view from, double max_time) const {
+  const auto it = stop_name_to_vertex_id_.find(from);
+  if (it == stop_name_to_vertex_id_.end()) {
+    return std::nullopt;
+  }
+  std::vector<ReachableStop> stops;
+  if (routing_settings_.router_mode == RouterMode::RAPTOR) {
+    const auto arrivals = raptor_.FindArrivals(it->second, max_time);
+    for (size_t i = 0; i < stop_names_.size(); ++i) {
+      if (arrivals[i] <= max_time) {
+        stops.push_back({stop_names_[i], arrivals[i]});
+      }
+    }
+  } else {
+    const auto weights =
+        router_.BuildRouteWeightsWithin(it->second, ToWeight(max_time));
+    for (const auto stop_name : stop_names_) {
+      const auto& weight = weights[stop_name_to_vertex_id_.at(stop_name)];
+      if (weight) {
+        stops.push_back({stop_name, ToMinutes(*weight)});
+      }
+    }
+  }
+  std::sort(stops.begin(), stops.end(),
+            [](const ReachableStop& lhs, const ReachableStop& rhs) {
+              return std::tie(lhs.time, lhs.stop_name) <
+                     std::tie(rhs.time, rhs.stop_name);
+            });
+  return stops;
+}
+
+std::shared_ptr<const TransportRouter::RouteRow> TransportRouter::GetRouteRow(
+    graph::VertexId from) const {
+  if (auto route_row = row_cache_.Find(from)) {
+    return *route_row;
+  }
+  auto route_row =
+      std::make_shared<const RouteRow>(router_.BuildRouteRow(from));
+  row_cache_.Insert(from, route_row);
+  return route_row;
+}
+
+std::optional<TransportRouter::GraphRouteInfo> TransportRouter::FindRoute(
+    graph::VertexId from, graph::VertexId to) const {
+  switch (routing_settings_.router_mode) {
+    case RouterMode::CONTRACTION_HIERARCHY:
+      return contraction_hierarchy_.BuildRoute(from, to);
+    case RouterMode::HUB_LABELS:
+      return hub_labels_.BuildRoute(from, to);
+    case RouterMode::A_STAR: {
+      // The router asks for the estimate once per reached vertex. Integer
+      // estimates are rounded down to stay admissible.
+      const auto target = vertex_coordinates_[to];
+      return router_.BuildRouteAStar(
+          from, to, [this, target](graph::VertexId vertex) {
+            const double distance =
+                geo::ComputeDistance(vertex_coordinates_[vertex], target);
+            return distance == 0.
+                       ? Weight{}
+                       : static_cast<Weight>(distance / max_velocity_);
+          });
+    }
+    case RouterMode::BIDIRECTIONAL:
+      return router_.BuildRouteBidirectional(from, to);
+    case RouterMode::LAZY_ROWS:
+      return router_.BuildRoute(*GetRouteRow(from), to);
+    default:
+      return router_.BuildRoute(from, to);
   }
-  return RouteInfo{route_info->weight, std::move(items)};
 }
 
 int TransportRouter::GetBusWaitTime() const {
   return routing_settings_.bus_wait_time;
 }
 
+const RoutingSettings& TransportRouter::GetRoutingSettings() const {
+  return routing_settings_;
+}
+
+lru_cache::CacheStats TransportRouter::GetRouteCacheStats() const {
+  return route_cache_.GetStats();
+}
+
+lru_cache::CacheStats TransportRouter::GetRowCacheStats() const {
+  return row_cache_.GetStats();
+}
+
 }  // namespace transport_router
\ No newline at end of file
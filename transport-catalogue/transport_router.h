@@ -1,24 +1,59 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
+#include "contraction_hierarchy.h"
+#include "geo.h"
 #include "graph.h"
+#include "hub_labels.h"
 #include "json.h"
+#include "lru_cache.h"
+#include "raptor.h"
+#include "route_weight.h"
 #include "router.h"
 #include "serialization.h"
+#include "thread_pool.h"
 #include "transport_catalogue.h"
 
 namespace transport_router {
 
 using TrCat = catalogue::TransportCatalogue;
-using Graph = graph::DirectedWeightedGraph<double>;
+using Graph = graph::DirectedWeightedGraph<Weight>;
+
+enum class RouterMode {
+  PRECOMPUTED,
+  ON_DEMAND,
+  CONTRACTION_HIERARCHY,
+  A_STAR,
+  BIDIRECTIONAL,
+  RAPTOR,
+  LAZY_ROWS,
+  HUB_LABELS
+};
+
+// COMPLETE links every stop of a bus to every later one, ROUTE_PATTERN adds a
+// vertex per stop of a bus instead and rides it one stop at a time
+enum class GraphModel { COMPLETE, ROUTE_PATTERN };
 
 struct RoutingSettings {
   int bus_wait_time;
   double bus_velocity;
+  RouterMode router_mode = RouterMode::PRECOMPUTED;
+  // Routes kept by the route cache, zero disables it
+  size_t route_cache_size = 0;
+  GraphModel graph_model = GraphModel::COMPLETE;
+  // Rows of the all-pairs table kept by the lazy rows mode, and whether
+  // process_requests writes them back to the base. With save_route_rows
+  // process_requests modifies the base file, replacing it as a whole.
+  size_t row_cache_size = 256;
+  bool save_route_rows = false;
 };
 
 struct Wait {
@@ -38,29 +73,139 @@ struct RouteInfo {
   std::optional<std::vector<RouteElement>> elements;
 };
 
+// Row per origin, column per destination, nullopt for no route
+using RouteMatrix = std::vector<std::vector<std::optional<double>>>;
+
+struct ReachableStop {
+  std::string_view stop_name;
+  double time;
+};
+
+// Once built or loaded, the router may serve queries from many threads at
+// once: searches keep their state per thread and the caches lock their
+// shards. The const members, from BuildRoute to GetRowCacheStats, are the
+// ones safe to call concurrently. Construction, loading, saving and Update
+// must not overlap with them or with each other.
 class TransportRouter {
  public:
-  TransportRouter(RoutingSettings rs, const TrCat& tc);
+  TransportRouter(RoutingSettings rs, const TrCat& tc,
+                  size_t thread_count = 1);
   std::optional<RouteInfo> BuildRoute(std::string_view from,
                                       std::string_view to) const;
+  // In the raptor mode these are the fastest routes for every number of
+  // buses that makes a route faster, in the others only the fastest route
+  std::vector<RouteInfo> BuildRouteAlternatives(std::string_view from,
+                                                std::string_view to) const;
+  RouteMatrix BuildRouteMatrix(const std::vector<std::string_view>& from,
+                               const std::vector<std::string_view>& to) const;
+  // Stops reachable from the stop within max_time minutes, fastest first,
+  // or nullopt if no bus stops there. One search bounded by max_time serves
+  // all of them, in every mode.
+  std::optional<std::vector<ReachableStop>> BuildIsochrone(
+      std::string_view from, double max_time) const;
   int GetBusWaitTime() const;
+  const RoutingSettings& GetRoutingSettings() const;
+  lru_cache::CacheStats GetRouteCacheStats() const;
+  lru_cache::CacheStats GetRowCacheStats() const;
+  // Rebuilds the router for its catalogue changed in place, or for a changed
+  // copy of it. Afterwards the router refers only to tc, the old names it
+  // compares are copied first. The precomputed table of the complete graph
+  // model is repaired in place if the stops are the same.
+  // Answers then match a router built anew, except that the repaired table
+  // may pick another of several equally light routes. Its weights match.
+  void Update(const TrCat& tc, size_t thread_count = 1);
 
   friend class serialization::Saver;
   friend class serialization::Loader;
 
  private:
   using VertexMap = std::unordered_map<std::string_view, graph::VertexId>;
-  using EdgeMap = std::unordered_map<graph::EdgeId, RouteElement>;
-  using EdgeStruct = graph::Edge<double>;
+  using EdgeStruct = graph::Edge<Weight>;
+  using GraphRouteInfo = graph::Router<Weight>::RouteInfo;
+  // Both vertex ids packed into one integer
+  using RouteCacheKey = uint64_t;
+  using RouteCache =
+      lru_cache::ShardedLruCache<RouteCacheKey, std::optional<RouteInfo>>;
+  using RouteRow = graph::Router<Weight>::RouteRow;
+  using RowCache =
+      lru_cache::ShardedLruCache<graph::VertexId,
+                                 std::shared_ptr<const RouteRow>>;
+
+  // What an edge stands for in a route. element_id is an index into
+  // stop_names_ for WAIT and into bus_names_ for BUS. Alighting edges of the
+  // route pattern model stand for nothing. The time of an item is the weight
+  // of its edge.
+  enum class EdgeKind : uint8_t { NONE, WAIT, BUS };
+
+  struct EdgeInfo {
+    uint32_t element_id;
+    uint16_t span_count;
+    EdgeKind kind;
+  };
+
+  // A bus's stops by router stop index, with the ride times between them
+  struct BusStops {
+    std::vector<uint32_t> stops;
+    std::vector<double> segment_times;
+  };
+
+  // Edges of one bus, built apart from the graph
+  struct EdgeBatch {
+    std::vector<EdgeStruct> edges;
+    std::vector<EdgeInfo> infos;
+  };
 
   TransportRouter(Graph&& g); 
-  Graph BuildVertexMapEdgeMapAndGraph(const TrCat& transport_catalogue);
+  Graph BuildVertexMapEdgeMapAndGraph(const TrCat& transport_catalogue,
+                                      size_t thread_count);
+  Graph BuildStopGraph();
+  void InitializeNames(const TrCat& transport_catalogue);
+  std::vector<uint32_t> GetStopIndices(const TrCat& transport_catalogue) const;
+  BusStops ResolveBus(const TrCat& transport_catalogue,
+                      const std::vector<uint32_t>& stop_indices,
+                      size_t bus_id) const;
+  std::vector<BusStops> ResolveBuses(const TrCat& transport_catalogue,
+                                     thread_pool::ThreadPool& pool) const;
+  std::vector<BusStops> ResolveBuses(const TrCat& transport_catalogue) const;
+  graph::EdgeId AddEdge(Graph& graph, const EdgeStruct& edge, EdgeInfo info);
+  void AddEdges(Graph& graph, const std::vector<EdgeBatch>& batches);
+  Graph BuildCompleteGraph(const TrCat& transport_catalogue,
+                           thread_pool::ThreadPool& pool);
+  Graph BuildRoutePatternGraph(const TrCat& transport_catalogue,
+                               thread_pool::ThreadPool& pool);
+  std::vector<graph::EdgeId> MatchEdges(
+      const Graph& old_graph, const std::vector<EdgeInfo>& old_edge_infos,
+      const std::vector<std::string>& old_bus_names) const;
+  void InitializeSearch(const TrCat& transport_catalogue);
+  void InitializeAStar(const TrCat& transport_catalogue);
+  void InitializeRaptor(const TrCat& transport_catalogue);
+  RouteInfo MakeRouteInfo(const raptor::Journey& journey) const;
+  std::shared_ptr<const RouteRow> GetRouteRow(graph::VertexId from) const;
+  std::optional<GraphRouteInfo> FindRoute(graph::VertexId from,
+                                          graph::VertexId to) const;
+  std::optional<RouteInfo> BuildRouteInfo(graph::VertexId from,
+                                          graph::VertexId to) const;
 
   RoutingSettings routing_settings_;
   VertexMap stop_name_to_vertex_id_;
-  EdgeMap edge_id_to_route_element_;
+  // Names by the stop and bus indices of the router, in the order the graph
+  // was built
+  std::vector<std::string_view> stop_names_;
+  std::vector<std::string_view> bus_names_;
+  // Indexed by edge id
+  std::vector<EdgeInfo> edge_infos_;
   Graph graph_;
-  graph::Router<double> router_;
+  graph::Router<Weight> router_;
+  graph::ContractionHierarchy<Weight> contraction_hierarchy_;
+  graph::HubLabels<Weight> hub_labels_;
+  std::vector<geo::Coordinates> vertex_coordinates_;
+  // Meters per weight unit, no edge of the graph is faster
+  double max_velocity_ = 0.;
+  mutable RouteCache route_cache_;
+  // The lazy rows mode searches a row on the first route from its origin
+  mutable RowCache row_cache_;
+  // Raptor's stops and routes are the router's stops and buses
+  raptor::Raptor raptor_;
 };
 
 }  // namespace transport_router